@@ -9,6 +9,7 @@ int main(int argc, char **argv) {
 	char defaultOutputName[] = "fft.csv";
 	
 	char *inputName, *outputName;
+	int binAmount = BIN_AMOUNT;
 	
 	if (argc >= 2) {
 		inputName = argv[1];
@@ -24,6 +25,16 @@ int main(int argc, char **argv) {
 		outputName = defaultOutputName;
 	}
 	
+	// The frames can also be mel or MFCC features, with fewer values
+	if (argc >= 4) {
+		binAmount = atoi(argv[3]);
+	}
+	
+	if (binAmount <= 0) {
+		printf("[ERROR] Invalid number of values per frame.\n");
+		exit(EXIT_FAILURE);
+	}
+	
 	FILE *input = fopen(inputName, "rb");
 	
 	if (input == NULL) {
@@ -40,10 +51,15 @@ int main(int argc, char **argv) {
 	
 	printf("Converting RAW FFT data to tab separated values.\n");
 	
-	float buffer[BIN_AMOUNT];
+	float *buffer = malloc(binAmount * sizeof(float));
 	int n;
 	
-	while ((n = fread(&buffer[0], sizeof(float), BIN_AMOUNT, input)) > 0) {
+	if (buffer == NULL) {
+		printf("[ERROR] Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	
+	while ((n = fread(&buffer[0], sizeof(float), binAmount, input)) > 0) {
 		int i;
 		for (i = 0; i < n; i++) {
 			fprintf(output, "%.6f;", buffer[i]);
@@ -52,6 +68,7 @@ int main(int argc, char **argv) {
 		fprintf(output, "\n");
 	}
 	
+	free(buffer);
 	printf("Conversion finished.\n");
 	
 	return EXIT_SUCCESS;
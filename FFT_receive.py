@@ -103,7 +103,7 @@ while nextBatchSizeInt != 0:
 print("Recording completed with success!")
 
 # decode adpcm to wav file
-dataExtraction = call(["FFT_extract", "fft.raw", fileName])
+dataExtraction = call(["FFT_extract", "fft.raw", fileName, str(expectedBatchSizeInt // 4)])
 
 if dataExtraction == 0:
 	print("FFT extraction completed")
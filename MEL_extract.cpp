@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "miosix-kernel/src/fft/mel_filterbank.h"
+
+#define FFT_SIZE 1024
+#define BIN_AMOUNT (FFT_SIZE / 2)
+#define SAMPLE_RATE 32000
+
+// Converts the FFT magnitudes sent in training mode (fft.raw) to the mel band energies or to the
+// MFCCs computed by the board with MEL_BANDS and MFCC_COEFFICIENTS, so that the recordings
+// made for the linear spectrum can be used to train a network on the new features.
+//
+// Compile with: g++ MEL_extract.cpp miosix-kernel/src/fft/mel_filterbank.cpp -o MEL_extract
+// Usage: MEL_extract [input] [output] [bands] [coefficients]
+
+int main(int argc, char **argv) {
+	char defaultInputName[] = "fft.raw";
+	char defaultOutputName[] = "mel.csv";
+	
+	char *inputName = argc >= 2 ? argv[1] : defaultInputName;
+	char *outputName = argc >= 3 ? argv[2] : defaultOutputName;
+	int bands = argc >= 4 ? atoi(argv[3]) : 40;
+	int coefficients = argc >= 5 ? atoi(argv[4]) : 0;
+	
+	if (argc < 3) {
+		printf("[INFO] Using %s as input and %s as output.\n", inputName, outputName);
+	}
+	
+	if (bands <= 0 || coefficients < 0 || coefficients > bands) {
+		printf("[ERROR] Invalid number of bands or coefficients.\n");
+		exit(EXIT_FAILURE);
+	}
+	
+	FILE *input = fopen(inputName, "rb");
+	
+	if (input == NULL) {
+		printf("[ERROR] Can't open %s.\n", inputName);
+		exit(EXIT_FAILURE);
+	}
+	
+	FILE *output = fopen(outputName, "w");
+	
+	if (output == NULL) {
+		printf("[ERROR] Can't open %s.\n", outputName);
+		exit(EXIT_FAILURE);
+	}
+	
+	printf("Converting RAW FFT data to %d %s.\n", coefficients > 0 ? coefficients : bands,
+			coefficients > 0 ? "MFCCs" : "mel band energies");
+	
+	MelFilterbank mel(FFT_SIZE, SAMPLE_RATE, bands, coefficients);
+	float buffer[BIN_AMOUNT];
+	float *features = new float[mel.getSize()];
+	
+	while (fread(&buffer[0], sizeof(float), BIN_AMOUNT, input) == BIN_AMOUNT) {
+		// The board computes the features from the power spectrum
+		for (int i = 0; i < BIN_AMOUNT; i++) {
+			buffer[i] *= buffer[i];
+		}
+		
+		mel.process(buffer, features);
+		
+		for (int i = 0; i < mel.getSize(); i++) {
+			fprintf(output, "%.6f;", features[i]);
+		}
+		
+		fprintf(output, "\n");
+	}
+	
+	delete[] features;
+	fclose(input);
+	fclose(output);
+	printf("Conversion finished.\n");
+	
+	return EXIT_SUCCESS;
+}
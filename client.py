@@ -5,7 +5,7 @@
 # Usage: keylogger.py serial_port_name
 # Example: py keylogger.py COM1
 
-import sys, serial
+import sys, serial, wave
 from serial import SerialException
 
 portName = "COM1"
@@ -50,7 +50,29 @@ print("Listening...\n")
 somethingPrinted = False
 message = ser.readline().decode()
 
+preRolls = 0
+
 while (message != "#stop"):
+	if (message.startswith("#preroll")):
+		# Audio retained before the event: "#preroll event rate samples", followed by the samples
+		fields = message.split()
+		size = int(fields[3]) * 2
+		data = b""
+
+		while (len(data) < size):
+			data += ser.read(size - len(data))
+
+		preRolls += 1
+		fileName = "%s_%d.wav" % (fields[1], preRolls)
+
+		with wave.open(fileName, "wb") as wav:
+			wav.setnchannels(1)
+			wav.setsampwidth(2)
+			wav.setframerate(int(fields[2]))
+			wav.writeframes(data)
+
+		message = "Audio saved to " + fileName
+
 	if (len(message) > 0):
 		print(message)
 	
@@ -0,0 +1,127 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "activity_detector.h"
+#include "../fft/fast_log.h"
+#include <stdexcept>
+
+// Lowest noise floor, to keep the threshold meaningful on digital silence
+#define MIN_NOISE_FLOOR -100.0f
+
+
+ActivityDetector::ActivityDetector(float hopTime, float threshold, float minZcr,
+                                   unsigned int hold, float rise, float activeRise)
+        : threshold(threshold), minZcr(minZcr), hold(hold), rise(rise * hopTime),
+          activeRise(activeRise * hopTime) {
+    if (hopTime <= 0)
+        throw std::invalid_argument("The hop time must be positive");
+
+    reset();
+}
+
+
+bool ActivityDetector::process(const short *pcm, unsigned int n) {
+    if (n < 2)
+        return true;
+
+    // Energy without the DC offset
+    int sum = 0;
+    long long squares = 0;
+
+    for (unsigned int i = 0; i < n; i++) {
+        sum += pcm[i];
+        squares += pcm[i] * pcm[i];
+    }
+
+    int mean = sum / (int) n;
+    float power = ((float) squares / n - (float) mean * mean) / (32768.0f * 32768.0f);
+    powerToDb(&power, &energy, 1);
+
+    // Zero crossings around the DC offset
+    unsigned int crossings = 0;
+    bool positive = pcm[0] > mean;
+
+    for (unsigned int i = 1; i < n; i++) {
+        bool current = pcm[i] > mean;
+        crossings += current != positive;
+        positive = current;
+    }
+
+    zcr = (float) crossings / (n - 1);
+
+    // The floor drops to the quieter frames immediately
+    if (noiseFloor > 0 || energy < noiseFloor)
+        noiseFloor = energy;
+
+    if (noiseFloor < MIN_NOISE_FLOOR)
+        noiseFloor = MIN_NOISE_FLOOR;
+
+    if (energy > noiseFloor + threshold && zcr >= minZcr) {
+        holdLeft = hold + 1;
+    } else if (holdLeft > 0) {
+        holdLeft--;
+    }
+
+    // ... and rises slowly, much more during the silence than during a sound, which would be
+    // absorbed otherwise
+    float step = holdLeft == 0 ? rise : activeRise;
+    noiseFloor += energy - noiseFloor < step ? energy - noiseFloor : step;
+
+    frames = frames + 1;
+
+    if (holdLeft == 0) {
+        skippedFrames = skippedFrames + 1;
+        return false;
+    }
+
+    return true;
+}
+
+
+void ActivityDetector::reset() {
+    energy = MIN_NOISE_FLOOR;
+    noiseFloor = 1;
+    zcr = 0;
+    holdLeft = 0;
+    frames = 0;
+    skippedFrames = 0;
+}
+
+
+float ActivityDetector::getEnergy() {
+    return energy;
+}
+
+
+float ActivityDetector::getNoiseFloor() {
+    return noiseFloor;
+}
+
+
+float ActivityDetector::getZcr() {
+    return zcr;
+}
+
+
+unsigned int ActivityDetector::getFrames() {
+    return frames;
+}
+
+
+unsigned int ActivityDetector::getSkippedFrames() {
+    return skippedFrames;
+}
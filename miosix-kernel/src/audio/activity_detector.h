@@ -0,0 +1,125 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef ACTIVITY_DETECTOR_H
+#define ACTIVITY_DETECTOR_H
+
+/**
+ * Sound activity detector working on the PCM frames, to skip the spectral analysis and the
+ * classification of the quiet ones.
+ *
+ * A frame is active when its energy (without the DC offset) exceeds the noise floor by a
+ * threshold and its zero crossing rate is high enough: this ignores the rumble and the
+ * handling noise, whose energy is concentrated at the lowest frequencies. The noise floor
+ * follows the quieter frames immediately and rises slowly otherwise: during the inactive frames
+ * it catches up with the small changes of the background, while during the active ones it rises
+ * at a much lower rate, so that a sound of a few seconds stays active but a stationary noise
+ * turning on (a fan, the air conditioning) becomes part of the background after a while.
+ * A frame after an active one is considered active too for a number of frames (hold), to keep
+ * the tails of the sounds.
+ */
+class ActivityDetector {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param hopTime       time between the starts of two consecutive frames, in seconds
+     * @param threshold     minimum energy above the noise floor of an active frame, in dB
+     * @param minZcr        minimum zero crossing rate of an active frame, in crossings per sample
+     * @param hold          number of frames considered active after the last active one
+     * @param rise          maximum increase of the noise floor during the inactive frames, in
+     *                      dB per second
+     * @param activeRise    maximum increase of the noise floor during the active frames, in dB
+     *                      per second
+     */
+    explicit ActivityDetector(float hopTime, float threshold = 9, float minZcr = 0.01f,
+                              unsigned int hold = 4, float rise = 5, float activeRise = 0.5f);
+
+
+    /**
+     * Analyze a frame.
+     *
+     * @param pcm       samples
+     * @param n         number of samples
+     * @return true if the frame is active; false if it can be treated as silence
+     */
+    bool process(const short *pcm, unsigned int n);
+
+
+    /**
+     * Forget the noise floor and clear the counters, to start a new session.
+     */
+    void reset();
+
+
+    /**
+     * Get the energy of the last frame.
+     *
+     * @return energy in dB relative to the full scale
+     */
+    float getEnergy();
+
+
+    /**
+     * Get the current noise floor.
+     *
+     * @return noise floor in dB relative to the full scale
+     */
+    float getNoiseFloor();
+
+
+    /**
+     * Get the zero crossing rate of the last frame.
+     *
+     * @return crossings per sample
+     */
+    float getZcr();
+
+
+    /**
+     * Get the number of frames analyzed since the last reset.
+     *
+     * @return number of frames
+     */
+    unsigned int getFrames();
+
+
+    /**
+     * Get the number of frames found quiet since the last reset.
+     *
+     * @return number of frames
+     */
+    unsigned int getSkippedFrames();
+
+
+private:
+    float threshold;
+    float minZcr;
+    unsigned int hold;
+    float rise;                 // Maximum increase of the noise floor at each inactive frame, in dB
+    float activeRise;           // Maximum increase of the noise floor at each active frame, in dB
+
+    float energy;               // Energy of the last frame, in dB
+    float noiseFloor;           // In dB, or above 0 if not measured yet
+    float zcr;                  // Zero crossing rate of the last frame
+    unsigned int holdLeft;      // Frames that will still be considered active
+    volatile unsigned int frames;
+    volatile unsigned int skippedFrames;
+};
+
+#endif /* ACTIVITY_DETECTOR_H */
@@ -0,0 +1,155 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef AUDIO_SOURCE_H
+#define AUDIO_SOURCE_H
+
+#include "../pdm/decimator.h"
+
+/**
+ * Type-erased frame sink: the function receives the sink context followed by the frame data,
+ * its size and the index of its first sample since the start of the recording.
+ * Unlike std::function, it never allocates memory.
+ */
+typedef void (*FrameHandler)(void*, const short*, unsigned int, unsigned long long);
+
+
+/**
+ * Frame handler calling a function known at compile time
+ */
+template<void (*Sink)(const short*, unsigned int, unsigned long long)>
+void callSinkFunction(void*, const short *frame, unsigned int size, unsigned long long firstSample) {
+    Sink(frame, size, firstSample);
+}
+
+
+/**
+ * Frame handler calling the operator() of the object passed as context
+ */
+template<typename Sink>
+void callSinkObject(void *context, const short *frame, unsigned int size, unsigned long long firstSample) {
+    (*static_cast<Sink*>(context))(frame, size, firstSample);
+}
+
+
+/**
+ * Type-erased PCM monitor: the function receives the monitor context followed by the new
+ * samples and their amount.
+ */
+typedef void (*PcmHandler)(void*, const short*, unsigned int);
+
+
+/**
+ * PCM handler calling the process method of the object passed as context
+ */
+template<typename Monitor>
+void callMonitorObject(void *context, const short *pcm, unsigned int count) {
+    static_cast<Monitor*>(context)->process(pcm, count);
+}
+
+
+/**
+ * Stream of PCM samples, delivered to a sink as overlapping frames
+ */
+class AudioSource {
+public:
+    virtual ~AudioSource() {};
+
+    /**
+     * Start the stream, delivering the frames to a function known at compile time.
+     * The sink receives the last frameSize samples every hopSize samples, so consecutive
+     * frames overlap by frameSize - hopSize samples.
+     *
+     * @tparam Sink         function to be called when the samples are ready (it receives the
+     *                      samples data pointer, their amount and the index of the first one
+     *                      since the start of the stream)
+     * @param frameSize     how many samples to pass to the sink
+     * @param hopSize       how many new samples to collect before executing the sink
+     *                      (must divide frameSize)
+     * @param rate          PCM sample rate
+     *
+     * @return true if the stream has started successfully; false otherwise
+     */
+    template<void (*Sink)(const short*, unsigned int, unsigned long long)>
+    bool start(unsigned int frameSize, unsigned int hopSize, PcmRate rate = PCM_32KHZ) {
+        return startSink(&callSinkFunction<Sink>, nullptr, frameSize, hopSize, rate);
+    }
+
+    /**
+     * Start the stream, delivering the frames to an object whose operator() has the signature
+     * void (const short*, unsigned int, unsigned long long). The object is not copied, so it
+     * must outlive the stream.
+     *
+     * @param sink          object to be called when the samples are ready
+     * @param frameSize     how many samples to pass to the sink
+     * @param hopSize       how many new samples to collect before executing the sink
+     *                      (must divide frameSize)
+     * @param rate          PCM sample rate
+     *
+     * @return true if the stream has started successfully; false otherwise
+     */
+    template<typename Sink>
+    bool start(Sink &sink, unsigned int frameSize, unsigned int hopSize, PcmRate rate = PCM_32KHZ) {
+        return startSink(&callSinkObject<Sink>, &sink, frameSize, hopSize, rate);
+    }
+
+    /**
+     * Stop the stream.
+     * The sink is not called anymore once this function returns.
+     */
+    virtual void stop() = 0;
+
+    /**
+     * Get the PCM sample rate of the current stream.
+     *
+     * @return sample rate in Hz; 0 if the stream has never been started
+     */
+    virtual unsigned int getSampleRate() = 0;
+
+    /**
+     * Get the actual PCM sample rate of the current stream, which may slightly differ from
+     * the nominal one because of the clock of the source.
+     *
+     * @return sample rate in Hz; 0 if the stream has never been started
+     */
+    virtual float getExactSampleRate() {
+        return getSampleRate();
+    }
+
+    /**
+     * Set a stage receiving the PCM samples as soon as they are produced, before they are
+     * grouped in frames: when a frame reaches the sink, the monitor has already seen all its
+     * samples. The monitor is called by the thread producing the samples, so it must be
+     * short. It can only be changed while the stream is stopped.
+     *
+     * @param monitor       object with a void process(const short*, unsigned int) method, or
+     *                      nullptr to remove the current one. It is not copied, so it must
+     *                      outlive the stream.
+     */
+    template<typename Monitor>
+    void setMonitor(Monitor *monitor) {
+        setMonitorHandler(monitor ? &callMonitorObject<Monitor> : nullptr, monitor);
+    }
+
+protected:
+    virtual bool startSink(FrameHandler handler, void *context, unsigned int frameSize,
+                           unsigned int hopSize, PcmRate rate) = 0;
+
+    virtual void setMonitorHandler(PcmHandler handler, void *context) = 0;
+};
+
+#endif /* AUDIO_SOURCE_H */
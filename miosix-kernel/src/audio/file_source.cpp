@@ -0,0 +1,340 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "file_source.h"
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _MIOSIX
+#include <miosix.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+/**
+ * Get the current time.
+ *
+ * @return time in microseconds
+ */
+static long long currentTime() {
+    #ifdef _MIOSIX
+        return miosix::getTick() * (1000000LL / miosix::TICK_FREQ);
+    #else
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+    #endif
+}
+
+
+/**
+ * Suspend the current thread.
+ *
+ * @param duration  time to sleep, in microseconds
+ */
+static void sleepFor(long long duration) {
+    #ifdef _MIOSIX
+        miosix::Thread::sleep(duration / 1000);
+    #else
+        usleep(duration);
+    #endif
+}
+
+
+static unsigned int readLittleEndian16(const unsigned char *bytes) {
+    return bytes[0] | (bytes[1] << 8u);
+}
+
+
+static unsigned int readLittleEndian32(const unsigned char *bytes) {
+    return readLittleEndian16(bytes) | (readLittleEndian16(bytes + 2) << 16u);
+}
+
+
+FileAudioSource::FileAudioSource(const char *path, AudioFormat format, bool realTime)
+        : file(nullptr), data(nullptr), size(0), position(0), remaining(0), format(format),
+          realTime(realTime), channels(1), sampleRate(0), ring(nullptr), decimator(nullptr),
+          handler(nullptr), context(nullptr), monitor(nullptr), monitorContext(nullptr),
+          threadStarted(false), running(false), streamed(0), startTime(0) {
+
+    file = fopen(path, "rb");
+
+    if (file == nullptr)
+        throw runtime_error("Audio file opening failed");
+}
+
+
+FileAudioSource::FileAudioSource(const void *data, size_t size, AudioFormat format, bool realTime)
+        : file(nullptr), data(static_cast<const unsigned char*>(data)), size(size), position(0),
+          remaining(0), format(format), realTime(realTime), channels(1), sampleRate(0),
+          ring(nullptr), decimator(nullptr), handler(nullptr), context(nullptr), monitor(nullptr),
+          monitorContext(nullptr), threadStarted(false), running(false), streamed(0), startTime(0) {
+
+}
+
+
+FileAudioSource::~FileAudioSource() {
+    stop();
+
+    if (file != nullptr)
+        fclose(file);
+
+    delete ring;
+    delete decimator;
+}
+
+
+bool FileAudioSource::startSink(FrameHandler handler, void *context, unsigned int frameSize,
+                                unsigned int hopSize, PcmRate rate) {
+    if (hopSize == 0 || hopSize > frameSize || frameSize % hopSize != 0)
+        return false;
+
+    // Join the thread of the previous stream, if any
+    stop();
+
+    // Rewind the recording
+    if (file != nullptr)
+        fseek(file, 0, SEEK_SET);
+
+    position = 0;
+    remaining = static_cast<size_t>(-1);
+    channels = 1;
+    sampleRate = rate;
+
+    // The WAV samples are not resampled, so the recording rate must be the requested one
+    if (format == AUDIO_WAV && !readWavHeader())
+        return false;
+
+    if (ring == nullptr || ring->getFrameSize() != frameSize || ring->getHopSize() != hopSize) {
+        delete ring;
+        ring = new PcmRing(frameSize, hopSize);
+    }
+
+    if (format == AUDIO_PDM && (decimator == nullptr || decimator->getSampleRate() != rate)) {
+        delete decimator;
+        decimator = new DecimationChain(rate);
+    }
+
+    ring->reset();
+
+    if (decimator != nullptr)
+        decimator->reset();
+
+    this->handler = handler;
+    this->context = context;
+    streamed = 0;
+    startTime = currentTime();
+    running = true;
+
+    if (pthread_create(&thread, nullptr, runLauncher, this) != 0) {
+        running = false;
+        return false;
+    }
+
+    threadStarted = true;
+    return true;
+}
+
+
+void FileAudioSource::stop() {
+    running = false;
+    wait();
+}
+
+
+unsigned int FileAudioSource::getSampleRate() {
+    return sampleRate;
+}
+
+
+void FileAudioSource::setMonitorHandler(PcmHandler handler, void *context) {
+    monitor = handler;
+    monitorContext = context;
+}
+
+
+void FileAudioSource::wait() {
+    if (threadStarted) {
+        pthread_join(thread, nullptr);
+        threadStarted = false;
+    }
+}
+
+
+void* FileAudioSource::runLauncher(void *arg) {
+    static_cast<FileAudioSource*>(arg)->run();
+    return nullptr;
+}
+
+
+void FileAudioSource::run() {
+    unsigned int space, produced;
+
+    while (running) {
+        if (format == AUDIO_PDM) {
+            unsigned int words = read(buffer, sizeof(buffer)) / sizeof(unsigned short);
+
+            if (words == 0)
+                break;
+
+            // Same transcoding of the microphone
+            unsigned int consumed = 0;
+
+            while (running && consumed < words) {
+                short *pcm = ring->getWritePointer(space);
+                consumed += decimator->process(buffer + consumed, words - consumed, pcm, space, produced);
+                commit(pcm, produced);
+            }
+
+        } else {
+            // The PCM samples are read directly into the ring
+            short *pcm = ring->getWritePointer(space);
+            produced = readPcm(pcm, space);
+
+            if (produced == 0)
+                break;
+
+            commit(pcm, produced);
+        }
+    }
+
+    running = false;
+}
+
+
+size_t FileAudioSource::read(void *buffer, size_t size) {
+    if (size > remaining)
+        size = remaining;
+
+    size_t count;
+
+    if (file != nullptr) {
+        count = fread(buffer, 1, size, file);
+    } else {
+        count = size < this->size - position ? size : this->size - position;
+        memcpy(buffer, data + position, count);
+        position += count;
+    }
+
+    remaining -= count;
+    return count;
+}
+
+
+bool FileAudioSource::skip(size_t size) {
+    while (size > 0) {
+        size_t count = read(buffer, size < sizeof(buffer) ? size : sizeof(buffer));
+
+        if (count == 0)
+            return false;
+
+        size -= count;
+    }
+
+    return true;
+}
+
+
+bool FileAudioSource::readWavHeader() {
+    unsigned char header[16];
+
+    if (read(header, 12) != 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+        return false;
+
+    bool formatFound = false;
+
+    // Look for the format and data chunks. The chunks are padded to an even size.
+    while (true) {
+        if (read(header, 8) != 8)
+            return false;
+
+        size_t chunkSize = readLittleEndian32(header + 4);
+        size_t padding = chunkSize & 1u;
+
+        if (memcmp(header, "data", 4) == 0) {
+            remaining = chunkSize;
+            return formatFound;
+        }
+
+        if (memcmp(header, "fmt ", 4) == 0) {
+            if (chunkSize < 16 || read(header, 16) != 16)
+                return false;
+
+            unsigned int encoding = readLittleEndian16(header);
+            channels = readLittleEndian16(header + 2);
+            unsigned int rate = readLittleEndian32(header + 4);
+            unsigned int bitsPerSample = readLittleEndian16(header + 14);
+
+            // Only 16 bit integer PCM is supported
+            if (encoding != 1 || bitsPerSample != 16 || channels == 0 || channels > blockSize || rate != sampleRate)
+                return false;
+
+            formatFound = true;
+            chunkSize -= 16;
+        }
+
+        if (!skip(chunkSize + padding))
+            return false;
+    }
+}
+
+
+unsigned int FileAudioSource::readPcm(short *pcm, unsigned int count) {
+    // The samples are stored in little endian, as in the memory of the board
+    if (channels == 1)
+        return read(pcm, count * sizeof(short)) / sizeof(short);
+
+    if (count > blockSize / channels)
+        count = blockSize / channels;
+
+    unsigned int frames = read(buffer, count * channels * sizeof(short)) / (channels * sizeof(short));
+
+    for (unsigned int i = 0; i < frames; i++) {
+        pcm[i] = static_cast<short>(buffer[i * channels]);
+    }
+
+    return frames;
+}
+
+
+void FileAudioSource::commit(const short *pcm, unsigned int count) {
+    streamed += count;
+
+    if (monitor)
+        monitor(monitorContext, pcm, count);
+
+    if (ring->commit(count)) {
+        handler(context, ring->getFrame(), ring->getFrameSize(), ring->getFrameStart());
+        pace();
+    }
+}
+
+
+void FileAudioSource::pace() {
+    if (!realTime)
+        return;
+
+    long long elapsed = currentTime() - startTime;
+    long long duration = static_cast<long long>(streamed * 1000000ULL / sampleRate);
+
+    if (duration > elapsed)
+        sleepFor(duration - elapsed);
+}
@@ -0,0 +1,179 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef FILE_SOURCE_H
+#define FILE_SOURCE_H
+
+#include <cstdio>
+#include <pthread.h>
+#include "audio_source.h"
+#include "pcm_ring.h"
+
+/**
+ * Formats of the recorded audio
+ */
+typedef enum {
+    AUDIO_PDM,      // Raw PDM, packed in 16 bit words (MSB first) as received by the I2S, at
+                    // the rate requested times DecimationChain::getDecimation
+    AUDIO_PCM,      // Raw mono 16 bit PCM at the rate requested when starting the stream
+    AUDIO_WAV       // 16 bit PCM WAV. Only the first channel is used.
+} AudioFormat;
+
+
+/**
+ * Audio source reading a recording from a file or from a memory buffer.
+ *
+ * The samples go through the same decimation and framing steps used for the microphone, but
+ * the sink is called by a thread of the source itself and no frame is ever dropped, so the
+ * output is reproducible. The recording can be streamed either as fast as the sink allows or
+ * at its real speed.
+ * The source does not depend on the board, so it can also be used on a PC.
+ */
+class FileAudioSource : public AudioSource {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param path      path of the file to be read
+     * @param format    format of the file
+     * @param realTime  true to stream the samples at the recording speed; false to stream
+     *                  them as fast as possible
+     */
+    FileAudioSource(const char *path, AudioFormat format, bool realTime = false);
+
+
+    /**
+     * Constructor
+     *
+     * @param data      recording (it is not copied, so it must outlive the source)
+     * @param size      size of the recording, in bytes
+     * @param format    format of the recording
+     * @param realTime  true to stream the samples at the recording speed; false to stream
+     *                  them as fast as possible
+     */
+    FileAudioSource(const void *data, size_t size, AudioFormat format, bool realTime = false);
+
+
+    /**
+     * Destructor.
+     * Stops the stream and closes the file.
+     */
+    ~FileAudioSource();
+
+
+    void stop() override;
+    unsigned int getSampleRate() override;
+
+
+    /**
+     * Wait for the whole recording to be delivered to the sink.
+     */
+    void wait();
+
+
+protected:
+    bool startSink(FrameHandler handler, void *context, unsigned int frameSize,
+                   unsigned int hopSize, PcmRate rate) override;
+    void setMonitorHandler(PcmHandler handler, void *context) override;
+
+
+private:
+
+    /**
+     * Stream the recording to the sink. Executed by the source thread.
+     */
+    void run();
+
+    static void* runLauncher(void *arg);
+
+    /**
+     * Read the next bytes of the recording.
+     *
+     * @param buffer    destination
+     * @param size      number of bytes to be read
+     * @return number of bytes actually read
+     */
+    size_t read(void *buffer, size_t size);
+
+    /**
+     * Skip the WAV header, checking that the samples can be streamed.
+     *
+     * @return true if the header is valid; false otherwise
+     */
+    bool readWavHeader();
+
+    /**
+     * Read the next PCM samples, keeping only the first channel.
+     *
+     * @param pcm       destination
+     * @param count     maximum number of samples
+     * @return number of samples read
+     */
+    unsigned int readPcm(short *pcm, unsigned int count);
+
+    /**
+     * Feed the PCM samples written at the write pointer of the ring to the monitor and to
+     * the ring, calling the sink for each completed frame.
+     *
+     * @param pcm       write pointer of the ring
+     * @param count     number of samples
+     */
+    void commit(const short *pcm, unsigned int count);
+
+    /**
+     * Wait for the time the samples streamed so far take to be recorded, if streaming in
+     * real time.
+     */
+    void pace();
+
+    /**
+     * Skip the next bytes of the recording.
+     *
+     * @param size      number of bytes to be skipped
+     * @return true if the bytes have been skipped; false if the recording is over
+     */
+    bool skip(size_t size);
+
+    static const unsigned int blockSize = 512;
+
+    FILE *file;
+    const unsigned char *data;
+    size_t size;
+    size_t position;            // Read position in the memory buffer
+    size_t remaining;           // Bytes left in the recording
+    AudioFormat format;
+    bool realTime;
+
+    unsigned short buffer[blockSize];   // PDM words or interleaved PCM samples being read
+    unsigned int channels;      // Channels of the WAV recording
+    unsigned int sampleRate;    // PCM sample rate of the current stream
+    PcmRing *ring;
+    DecimationChain *decimator;
+    FrameHandler handler;
+    void *context;
+    PcmHandler monitor;
+    void *monitorContext;
+
+    pthread_t thread;
+    bool threadStarted;         // Whether the thread has to be joined
+    volatile bool running;      // Cleared to stop the thread
+    unsigned long long streamed;    // PCM samples delivered since the start
+    long long startTime;        // Start time of the stream, in microseconds
+};
+
+#endif /* FILE_SOURCE_H */
@@ -0,0 +1,194 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "onset_detector.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+// Minimum number of samples before the new part of the frame to measure the background
+#define MIN_BACKGROUND_SAMPLES 32
+
+
+OnsetDetector::OnsetDetector(unsigned int bins, float sensitivity, float minFlux, unsigned int refractory,
+                             float adaptation)
+        : bins(bins), sensitivity(sensitivity), minFlux(minFlux), refractory(refractory), adaptation(adaptation) {
+
+    if (bins == 0) {
+        throw invalid_argument("Invalid number of bins");
+    }
+
+    previous = (float*) malloc(bins * sizeof(float));
+
+    if (!previous) {
+        throw runtime_error("Spectrum buffer allocation failed");
+    }
+
+    reset();
+}
+
+
+OnsetDetector::~OnsetDetector() {
+    free(previous);
+}
+
+
+bool OnsetDetector::process(const float *spectrum, const short *pcm, unsigned int n,
+                            unsigned long long firstSample) {
+    // Half-wave rectified difference with the previous frame
+    float rise = 0, total = 0;
+
+    for (unsigned int i = 0; i < bins; i++) {
+        float difference = spectrum[i] - previous[i];
+        rise += difference > 0 ? difference : 0;
+        total += spectrum[i];
+    }
+
+    memcpy(previous, spectrum, bins * sizeof(float));
+
+    // Samples not present in the previous frame
+    unsigned long long fresh = first || firstSample - lastSample > n ? n : firstSample - lastSample;
+    lastSample = firstSample;
+
+    if (first) {
+        first = false;
+        flux = 0;
+        return false;
+    }
+
+    flux = total > 0 ? rise / total : 0;
+    float threshold = getThreshold();
+    bool found = false;
+
+    if (refractoryLeft > 0) {
+        refractoryLeft--;
+
+    } else if (flux > threshold && n > 0) {
+        // The flux can peak a frame after the beginning of the sound, so the new samples of the
+        // previous frame are searched too
+        unsigned int start = n > 2 * fresh ? n - 2 * (unsigned int) fresh : 0;
+        onset = firstSample + locate(pcm, n, start);
+        onsetFrame = firstSample;
+        onsets = onsets + 1;
+        refractoryLeft = refractory;
+        found = true;
+
+    } else {
+        // No sound is starting, so the whole frame is background
+        measureBackground(pcm, n, n);
+    }
+
+    // The onsets are part of the statistics too, so that a sequence of them raises the threshold
+    float difference = fabsf(flux - mean);
+    mean += adaptation * (flux - mean);
+    deviation += adaptation * (difference - deviation);
+
+    return found;
+}
+
+
+int OnsetDetector::measureBackground(const short *pcm, unsigned int n, unsigned int count) {
+    int sum = 0;
+
+    for (unsigned int i = 0; i < n; i++) {
+        sum += pcm[i];
+    }
+
+    int offset = n > 0 ? sum / (int) n : 0;
+
+    // If the samples are too few, the background of the previous frames is kept
+    if (count >= MIN_BACKGROUND_SAMPLES) {
+        long long squares = 0;
+
+        for (unsigned int i = 0; i < count; i++) {
+            int value = pcm[i] - offset;
+            squares += (long long) value * value;
+        }
+
+        background = sqrtf((float) squares / count);
+    }
+
+    return offset;
+}
+
+
+unsigned int OnsetDetector::locate(const short *pcm, unsigned int n, unsigned int start) {
+    // Background before the new samples
+    int offset = measureBackground(pcm, n, start);
+
+    int peak = 0;
+
+    for (unsigned int i = start; i < n; i++) {
+        int value = abs(pcm[i] - offset);
+        peak = value > peak ? value : peak;
+    }
+
+    // The onset is where the envelope crosses the level halfway between the two, in dB
+    float level = sqrtf((background > 1 ? background : 1) * peak);
+
+    for (unsigned int i = start; i < n; i++) {
+        if (abs(pcm[i] - offset) >= level) {
+            return i;
+        }
+    }
+
+    return start;
+}
+
+
+void OnsetDetector::reset() {
+    memset(previous, 0, bins * sizeof(float));
+    first = true;
+    lastSample = 0;
+    flux = 0;
+    mean = 0;
+    deviation = 0;
+    background = 0;
+    refractoryLeft = 0;
+    onset = 0;
+    onsetFrame = 0;
+    onsets = 0;
+}
+
+
+unsigned long long OnsetDetector::getOnset() {
+    return onset;
+}
+
+
+unsigned long long OnsetDetector::getOnsetFrame() {
+    return onsetFrame;
+}
+
+
+float OnsetDetector::getFlux() {
+    return flux;
+}
+
+
+float OnsetDetector::getThreshold() {
+    float threshold = mean + sensitivity * deviation;
+    return threshold > minFlux ? threshold : minFlux;
+}
+
+
+unsigned int OnsetDetector::getOnsets() {
+    return onsets;
+}
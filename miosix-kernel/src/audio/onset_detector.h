@@ -0,0 +1,156 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef ONSET_DETECTOR_H
+#define ONSET_DETECTOR_H
+
+/**
+ * Onset detector based on the spectral flux: the sum of the increases of the bins between two
+ * consecutive frames (half-wave rectified, so the decays are ignored), divided by the sum of
+ * the bins of the new frame. A sound starting abruptly gives a value close to 1.
+ *
+ * The threshold adapts to the background: it is the mean of the flux plus a number of times its
+ * mean absolute deviation, both averaged exponentially over the frames, and never lower than a
+ * minimum. After an onset, the following frames are ignored for a while (refractory period).
+ *
+ * The onset is then located in the samples of the frame: it is the first sample of the new part
+ * of the frame whose amplitude exceeds the geometric mean of the amplitude of the background
+ * (the RMS value before the new part) and the peak amplitude.
+ */
+class OnsetDetector {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param bins          number of bins of the spectrum (magnitudes or powers, not in dB)
+     * @param sensitivity   number of mean absolute deviations of the threshold above the mean flux
+     * @param minFlux       minimum threshold, between 0 and 1
+     * @param refractory    number of frames ignored after an onset
+     * @param adaptation    weight of each new frame in the mean and deviation of the flux
+     */
+    explicit OnsetDetector(unsigned int bins, float sensitivity = 4, float minFlux = 0.3f,
+                           unsigned int refractory = 4, float adaptation = 0.05f);
+
+
+    /**
+     * Destructor.
+     * Frees the previous spectrum.
+     */
+    ~OnsetDetector();
+
+
+    /**
+     * Analyze a frame.
+     *
+     * @param spectrum      bins of the frame
+     * @param pcm           samples of the frame
+     * @param n             number of samples
+     * @param firstSample   index of the first sample of the frame in the stream. The frames
+     *                      can overlap or be separated by gaps.
+     * @return true if an onset has been found
+     */
+    bool process(const float *spectrum, const short *pcm, unsigned int n, unsigned long long firstSample);
+
+
+    /**
+     * Forget the previous frames and clear the counters, to start a new session.
+     */
+    void reset();
+
+
+    /**
+     * Get the position of the last onset.
+     *
+     * @return index of the sample in the stream
+     */
+    unsigned long long getOnset();
+
+
+    /**
+     * Get the frame where the last onset has been found.
+     *
+     * @return index of the first sample of the frame in the stream
+     */
+    unsigned long long getOnsetFrame();
+
+
+    /**
+     * Get the spectral flux of the last frame.
+     *
+     * @return flux, between 0 and 1
+     */
+    float getFlux();
+
+
+    /**
+     * Get the current threshold of the flux.
+     *
+     * @return threshold, between 0 and 1
+     */
+    float getThreshold();
+
+
+    /**
+     * Get the number of onsets found since the last reset.
+     *
+     * @return number of onsets
+     */
+    unsigned int getOnsets();
+
+
+private:
+    /**
+     * Measure the RMS amplitude of the first samples of a frame, around its DC offset
+     *
+     * @param pcm       samples
+     * @param n         number of samples of the frame
+     * @param count     number of samples of the background
+     * @return DC offset of the frame
+     */
+    int measureBackground(const short *pcm, unsigned int n, unsigned int count);
+
+    /**
+     * Find the onset in the samples of a frame
+     *
+     * @param pcm       samples
+     * @param n         number of samples
+     * @param start     first sample where the onset can be
+     * @return index of the onset sample in the frame
+     */
+    unsigned int locate(const short *pcm, unsigned int n, unsigned int start);
+
+    unsigned int bins;
+    float sensitivity;
+    float minFlux;
+    unsigned int refractory;
+    float adaptation;
+
+    float *previous;                // Spectrum of the previous frame
+    bool first;                     // Whether no frame has been analyzed yet
+    unsigned long long lastSample;  // First sample of the previous frame
+    float flux;
+    float mean;                     // Average flux
+    float deviation;                // Average absolute deviation of the flux
+    float background;               // RMS amplitude of the background
+    unsigned int refractoryLeft;    // Frames that will still be ignored
+    unsigned long long onset;
+    unsigned long long onsetFrame;  // First sample of the frame of the last onset
+    volatile unsigned int onsets;
+};
+
+#endif /* ONSET_DETECTOR_H */
@@ -0,0 +1,176 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "pcm_ring.h"
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+
+PcmRing::PcmRing(unsigned int frameSize, unsigned int hopSize, unsigned int retention)
+        : frameSize(frameSize), hopSize(hopSize), retention(retention) {
+
+    if (hopSize == 0 || hopSize > frameSize || frameSize % hopSize != 0) {
+        throw invalid_argument("Invalid hop size");
+    }
+
+    // The frozen samples are followed by the space needed to keep producing frames. The capacity
+    // must be a multiple of the hop size.
+    capacity = (retention + hopSize - 1) / hopSize * hopSize + frameSize + hopSize;
+    mirrorSize = frameSize - hopSize;
+    samples = (short*) malloc((capacity + mirrorSize) * sizeof(short));
+
+    if (!samples) {
+        throw runtime_error("PCM buffer allocation failed");
+    }
+
+    reset();
+}
+
+
+PcmRing::~PcmRing() {
+    free(samples);
+}
+
+
+void PcmRing::reset() {
+    position = 0;
+    hopFill = 0;
+    filled = 0;
+    frame = samples;
+    written = 0;
+    frozen = false;
+    retainedStart = 0;
+    retainedEnd = 0;
+}
+
+
+short* PcmRing::getWritePointer(unsigned int &space) {
+    // The capacity is a multiple of the hop size, so a hop never wraps around
+    space = hopSize - hopFill;
+
+    if (frozen) {
+        unsigned int free = writeLimit - (unsigned int) written;
+        space = free < space ? free : space;
+    }
+
+    return &samples[position];
+}
+
+
+bool PcmRing::commit(unsigned int count) {
+    // Mirror the samples written at the beginning of the ring
+    if (position < mirrorSize) {
+        unsigned int length = position + count < mirrorSize ? count : mirrorSize - position;
+        memcpy(&samples[capacity + position], &samples[position], length * sizeof(short));
+    }
+
+    position += count;
+    hopFill += count;
+    written += count;
+
+    if (position == capacity)
+        position = 0;
+
+    if (filled < frameSize)
+        filled += count;
+
+    if (hopFill < hopSize)
+        return false;
+
+    hopFill = 0;
+
+    if (filled < frameSize)
+        return false;
+
+    // The frame ends at the write position. Thanks to the mirror it never crosses the end
+    // of the buffer.
+    frame = &samples[position >= frameSize ? position - frameSize : position + capacity - frameSize];
+    return true;
+}
+
+
+const short* PcmRing::getFrame() {
+    return frame;
+}
+
+
+unsigned long long PcmRing::getFrameStart() {
+    return filled < frameSize ? 0 : written - hopFill - frameSize;
+}
+
+
+unsigned int PcmRing::freeze() {
+    if (frozen)
+        return 0;
+
+    unsigned int count = written < retention ? written : retention;
+
+    retainedEnd = written;
+    retainedStart = written - count;
+    writeLimit = (unsigned int) (retainedStart + capacity);
+    frozen = count > 0;
+
+    return count;
+}
+
+
+const short* PcmRing::getRetained(unsigned int &count) {
+    if (!frozen) {
+        count = 0;
+        return samples;
+    }
+
+    unsigned int start = retainedStart % capacity;
+    unsigned long long left = retainedEnd - retainedStart;
+    count = left < capacity - start ? left : capacity - start;
+
+    return &samples[start];
+}
+
+
+void PcmRing::release(unsigned int count) {
+    retainedStart += count;
+
+    if (retainedStart >= retainedEnd) {
+        frozen = false;
+    } else {
+        writeLimit = (unsigned int) (retainedStart + capacity);
+    }
+}
+
+
+unsigned int PcmRing::getFrameSize() {
+    return frameSize;
+}
+
+
+unsigned int PcmRing::getHopSize() {
+    return hopSize;
+}
+
+
+unsigned int PcmRing::getCapacity() {
+    return capacity;
+}
+
+
+unsigned int PcmRing::getRetention() {
+    return retention;
+}
@@ -0,0 +1,183 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef PCM_RING_H
+#define PCM_RING_H
+
+/**
+ * Circular PCM history from which overlapping analysis frames are taken.
+ *
+ * A new frame is available every hopSize samples and is made of the last frameSize samples.
+ * Frames are returned as pointers into the ring, without copying them: the first
+ * frameSize - hopSize samples of the ring are mirrored after its end, so that a frame
+ * wrapping around is contiguous anyway.
+ *
+ * The ring holds frameSize + hopSize samples, so that the producer can write the next hop
+ * while the last frame is being consumed.
+ *
+ * Optionally, the ring also retains the last samples before an event (pre-roll), so that they
+ * can be saved without copying them elsewhere. When the ring is frozen, the retained samples
+ * are not overwritten until they are released by the reader, which can be another thread. In
+ * the meanwhile the producer can write only frameSize + hopSize samples: then the write space
+ * stays zero until the reader releases some samples.
+ */
+class PcmRing {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param frameSize     number of samples of each frame
+     * @param hopSize       number of samples between the beginning of two consecutive frames
+     *                      (must divide frameSize)
+     * @param retention     number of samples to be kept for the pre-roll
+     */
+    PcmRing(unsigned int frameSize, unsigned int hopSize, unsigned int retention = 0);
+
+
+    /**
+     * Destructor.
+     * Frees the samples buffer.
+     */
+    ~PcmRing();
+
+
+    /**
+     * Discard all the samples and unfreeze the ring.
+     * The next frame will be available after frameSize samples.
+     */
+    void reset();
+
+
+    /**
+     * Get the position where the next samples have to be written.
+     *
+     * @param space     number of samples that can be written contiguously (up to the end
+     *                  of the current hop, or of the space left by the frozen samples)
+     * @return write pointer
+     */
+    short* getWritePointer(unsigned int &space);
+
+
+    /**
+     * Notify that samples have been written at the write pointer.
+     *
+     * @param count     number of samples written (not more than the available space)
+     * @return true if a new frame is complete
+     */
+    bool commit(unsigned int count);
+
+
+    /**
+     * Get the last complete frame.
+     * The frame stays valid until other hopSize samples are committed.
+     *
+     * @return pointer to frameSize contiguous samples
+     */
+    const short* getFrame();
+
+
+    /**
+     * Get the position of the last complete frame in the recorded stream.
+     *
+     * @return index of the first sample of the frame, counted from the reset
+     */
+    unsigned long long getFrameStart();
+
+
+    /**
+     * Freeze the pre-roll, that is the last retention samples written.
+     * Must be called by the producer.
+     *
+     * @return number of samples frozen (less than the retention if not enough samples have
+     *         been written since the reset)
+     */
+    unsigned int freeze();
+
+
+    /**
+     * Get the oldest frozen samples not yet released.
+     *
+     * @param count     number of samples available contiguously (0 if the ring is not frozen)
+     * @return pointer to the samples
+     */
+    const short* getRetained(unsigned int &count);
+
+
+    /**
+     * Release the oldest frozen samples, so that the producer can overwrite them.
+     * The ring is unfrozen when all the frozen samples have been released.
+     *
+     * @param count     number of samples (not more than the ones returned by getRetained)
+     */
+    void release(unsigned int count);
+
+
+    /**
+     * Get the frame size.
+     *
+     * @return number of samples of each frame
+     */
+    unsigned int getFrameSize();
+
+
+    /**
+     * Get the hop size.
+     *
+     * @return number of samples between two consecutive frames
+     */
+    unsigned int getHopSize();
+
+
+    /**
+     * Get the length of the ring: a frame is overwritten once the samples written after its
+     * first one reach this number.
+     *
+     * @return number of samples, excluding the mirrored ones
+     */
+    unsigned int getCapacity();
+
+
+    /**
+     * Get the pre-roll size.
+     *
+     * @return number of samples retained by the freeze
+     */
+    unsigned int getRetention();
+
+
+private:
+    unsigned int frameSize;
+    unsigned int hopSize;
+    unsigned int capacity;      // Ring length, excluding the mirrored part
+    unsigned int mirrorSize;    // Number of samples at the beginning of the ring mirrored after its end
+    short* samples;             // Ring buffer. Its length is capacity + mirrorSize.
+    unsigned int position;      // Write position
+    unsigned int hopFill;       // Number of samples written in the current hop
+    unsigned int filled;        // Number of samples written since the reset, up to frameSize
+    const short* frame;         // Last complete frame
+    unsigned long long written; // Number of samples written since the reset
+    unsigned int retention;
+
+    // Pre-roll state. The producer only reads it, apart from the freeze.
+    volatile bool frozen;
+    volatile unsigned int writeLimit;   // Lowest 32 bits of the index of the first sample that can't be written
+    unsigned long long retainedStart;   // Index of the first frozen sample not yet released
+    unsigned long long retainedEnd;     // Index of the sample following the last frozen one
+};
+
+#endif /* PCM_RING_H */
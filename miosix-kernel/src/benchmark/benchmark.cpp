@@ -0,0 +1,619 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "benchmark.h"
+#include "cycles.h"
+#include "../fft/feature_normalizer.h"
+#include "../fft/fft.h"
+#include "../fft/front_end.h"
+#include "../fft/goertzel.h"
+#include "../fft/multi_resolution.h"
+#include "../fft/pitch_estimator.h"
+#include "../fft/sliding_dft.h"
+#include "../fft/spectrogram.h"
+#include "../fft/window.h"
+#include "../pdm/pdm_decimator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+
+/**
+ * Reference PDM filter: 4th order CIC decimating by 16, integrating one bit at a time.
+ * The output saturates instead of wrapping around, as the one of PdmDecimator.
+ */
+class BitSerialCic {
+public:
+    short filter(unsigned short pdmWord) {
+        for (unsigned short i = 0; i < 16; i++) {
+            intReg[0] += (pdmWord >> (15u - i)) & 1u ? 1 : -1;
+
+            for (short j = 1; j < 4; j++) {
+                intReg[j] += intReg[j-1];
+            }
+        }
+
+        int32_t combInput = intReg[3], combRes = 0;
+
+        for (int32_t &i : combReg) {
+            combRes = combInput - i;
+            i = combInput;
+            combInput = combRes;
+        }
+
+        return saturate16(combRes);
+    }
+
+private:
+    int32_t intReg[4] = {0, 0, 0, 0};
+    int32_t combReg[4] = {0, 0, 0, 0};
+};
+
+
+/**
+ * Compare the table-driven CIC decimator against the bit-serial one on a random PDM stream
+ */
+static void benchmarkCic() {
+    const unsigned int words = 2048;
+    const unsigned int rounds = 16;
+    static unsigned short pdm[words];
+    static short refOut[words], lutOut[words];
+
+    static BitSerialCic reference;
+    static PdmDecimator<4, 16> decimator;
+    unsigned int refCycles = 0, lutCycles = 0, mismatches = 0;
+
+    for (unsigned int r = 0; r < rounds; r++) {
+        for (unsigned int i = 0; i < words; i++) {
+            pdm[i] = rand() & 0xffffu;
+        }
+
+        unsigned int start = cycleCount();
+
+        for (unsigned int i = 0; i < words; i++) {
+            refOut[i] = reference.filter(pdm[i]);
+        }
+
+        unsigned int middle = cycleCount();
+        decimator.process(pdm, words, lutOut);
+        unsigned int end = cycleCount();
+
+        refCycles += middle - start;
+        lutCycles += end - middle;
+
+        for (unsigned int i = 0; i < words; i++) {
+            if (refOut[i] != lutOut[i]) {
+                mismatches++;
+            }
+        }
+    }
+
+    unsigned int samples = words * rounds;
+
+    printf("CIC: %u samples, %u mismatches\r\n", samples, mismatches);
+    printf("CIC: bit-serial %.1f cycles/sample, table %.1f cycles/sample, speedup %.2fx\r\n",
+           (float) refCycles / samples, (float) lutCycles / samples, (float) refCycles / lutCycles);
+}
+
+
+/**
+ * Reference window: copy of the per-sample interface the front end replaced, with a virtual call
+ * for each sample and double precision coefficients. The coefficients are the ones of the
+ * window being compared, so that the outputs match.
+ */
+class PerSampleWindow {
+public:
+    virtual ~PerSampleWindow() {};
+    virtual float apply(float value, int index) = 0;
+};
+
+
+class PerSampleTableWindow : public PerSampleWindow {
+public:
+    PerSampleTableWindow(const float *coefficients, size_t size) {
+        multipliers = (double*) malloc(size * sizeof(double));
+
+        if (multipliers == nullptr)
+            throw runtime_error("Window allocation failed");
+
+        for (size_t i = 0; i < size; i++) {
+            multipliers[i] = coefficients[i];
+        }
+    }
+
+    ~PerSampleTableWindow() {
+        free(multipliers);
+    }
+
+    // Not inlined, as it was defined in another translation unit
+    __attribute__((noinline)) float apply(float value, int index) override {
+        return value * multipliers[index];
+    }
+
+private:
+    double *multipliers;
+};
+
+
+/**
+ * Process a random signal with an FFT.
+ *
+ * @param fft       FFT to be used
+ * @param seed      seed of the signal
+ * @param rounds    number of times the FFT is computed
+ * @return average cycles per FFT
+ */
+static unsigned int runFft(FFT &fft, unsigned int seed, unsigned int rounds) {
+    unsigned int cycles = 0;
+
+    for (unsigned int r = 0; r < rounds; r++) {
+        srand(seed);
+
+        for (unsigned int i = 0; i < fft.getSize(); i++) {
+            fft.addSample((float) rand() / RAND_MAX - 0.5f);
+        }
+
+        unsigned int start = cycleCount();
+        fft.process();
+        cycles += cycleCount() - start;
+    }
+
+    return cycles / rounds;
+}
+
+
+/**
+ * Compare the real FFT against the complex one at every supported size
+ */
+static void benchmarkFft() {
+    const unsigned int rounds = 8;
+
+    for (unsigned int size = 16; size <= 4096; size *= 2) {
+        // The FFTs are created one at a time, to fit the largest sizes in memory
+        float *reference = (float*) malloc(size / 2 * sizeof(float));
+        unsigned int complexCycles;
+
+        {
+            FFT complexFft(size, FFT_COMPLEX);
+            complexCycles = runFft(complexFft, size, rounds);
+
+            for (unsigned int i = 0; i < size / 2; i++) {
+                reference[i] = complexFft.getBin(i);
+            }
+        }
+
+        try {
+            FFT realFft(size, FFT_REAL);
+            unsigned int realCycles = runFft(realFft, size, rounds);
+            float maxError = 0, maxBin = 0;
+
+            for (unsigned int i = 0; i < size / 2; i++) {
+                float error = fabsf(realFft.getBin(i) - reference[i]);
+                maxError = error > maxError ? error : maxError;
+                maxBin = reference[i] > maxBin ? reference[i] : maxBin;
+            }
+
+            printf("FFT %u: complex %u cycles, real %u cycles, speedup %.2fx, max error %.2e\r\n",
+                   size, complexCycles, realCycles, (float) complexCycles / realCycles, maxError / maxBin);
+
+        } catch (invalid_argument &e) {
+            printf("FFT %u: complex %u cycles, real not supported\r\n", size, complexCycles);
+        }
+
+        free(reference);
+    }
+}
+
+
+/**
+ * Compare the processing time of the output types of the FFT
+ */
+static void benchmarkFftOutput() {
+    const unsigned int size = 1024;
+    const unsigned int rounds = 8;
+    const char* names[] = {"magnitude", "power", "log power"};
+    unsigned int cycles[3];
+
+    for (unsigned int i = 0; i < 3; i++) {
+        FFT fft(size, FFT_REAL, (FftOutput) i);
+        cycles[i] = runFft(fft, size, rounds);
+    }
+
+    for (unsigned int i = 0; i < 3; i++) {
+        printf("FFT %u %s: %u cycles, %.2fx\r\n", size, names[i], cycles[i], (float) cycles[0] / cycles[i]);
+    }
+}
+
+
+/**
+ * Reference sample normalization, computing the divisor at each call
+ */
+template<typename T>
+static float normalize(T value, bool sign) {
+    float result;
+
+    // Determine the divisor
+    T *normalizationFactor = (T*) malloc(sizeof(T));
+
+    // Set all the bits to 1
+    for (unsigned int i = 0; i < sizeof(T); i++) {
+        for (unsigned int j = 0; j < 8; j++) {
+            *((char*) normalizationFactor + i) |= 1u << j;
+        }
+    }
+
+    // Set the first bit to 0 in case of signed type
+    if (sign) {
+        *normalizationFactor &= ~(1ull << (8 * sizeof(T) - 1));
+    }
+
+    // Normalize
+    result = value / ((float) *normalizationFactor + 1);
+
+    free(normalizationFactor);
+    return result;
+}
+
+
+/**
+ * Compare the block front end against the per-sample normalization, windowing and copy
+ */
+static void benchmarkFrontEnd() {
+    const unsigned int size = 1024;
+    const unsigned int rounds = 16;
+    static short pcm[size];
+    static float reference[size];
+
+    FFT fft(size, FFT_REAL);
+    HannWindow window(size);
+    FrontEnd frontEnd(window);
+    PerSampleTableWindow perSampleWindow(window.getCoefficients(), size);
+    PerSampleWindow *baseline = &perSampleWindow;
+    unsigned int refCycles = 0, blockCycles = 0;
+    float maxError = 0;
+
+    for (unsigned int r = 0; r < rounds; r++) {
+        for (unsigned int i = 0; i < size; i++) {
+            pcm[i] = rand() & 0xffffu;
+        }
+
+        unsigned int start = cycleCount();
+
+        // Loop replaced by the front end
+        for (unsigned int i = 0; i < size; i++) {
+            float value = normalize<short>(pcm[i], true);
+            value = baseline->apply(value, i);
+            fft.addSample(value);
+        }
+
+        unsigned int end = cycleCount();
+        refCycles += end - start;
+        memcpy(reference, fft.getInput(), sizeof(reference));
+
+        start = cycleCount();
+        frontEnd.process(pcm, size, fft.getInput());
+        blockCycles += cycleCount() - start;
+
+        for (unsigned int i = 0; i < size; i++) {
+            float error = fabsf(fft.getInput()[i] - reference[i]);
+            maxError = error > maxError ? error : maxError;
+        }
+
+        fft.process();
+    }
+
+    unsigned int samples = size * rounds;
+
+    printf("Front end: per-sample %.1f cycles/sample, block %.1f cycles/sample, speedup %.2fx, max error %.2e\r\n",
+           (float) refCycles / samples, (float) blockCycles / samples, (float) refCycles / blockCycles, maxError);
+}
+
+
+/**
+ * Compare the Goertzel bank with the FFT on the same frame, and check its power against
+ * a full scale sine
+ */
+static void benchmarkGoertzel() {
+    const unsigned int size = 1024;
+    const unsigned int rounds = 8;
+    const float rate = 32000;
+    const float frequencies[] = {800, 1200, 1600, 2000, 2500, 3000};
+    const unsigned int count = sizeof(frequencies) / sizeof(frequencies[0]);
+    static short pcm[size];
+
+    GoertzelBank bank(frequencies, count, rate, 256);
+    FFT fft(size, FFT_REAL);
+    HannWindow window(size);
+    FrontEnd frontEnd(window);
+    unsigned int goertzelCycles = 0, fftCycles = 0;
+
+    for (unsigned int r = 0; r < rounds; r++) {
+        for (unsigned int i = 0; i < size; i++) {
+            pcm[i] = rand() & 0xffffu;
+        }
+
+        unsigned int start = cycleCount();
+        bank.process(pcm, size);
+        unsigned int middle = cycleCount();
+        frontEnd.process(pcm, size, fft.getInput());
+        fft.process();
+        unsigned int end = cycleCount();
+
+        goertzelCycles += middle - start;
+        fftCycles += end - middle;
+    }
+
+    // A full scale sine at one of the frequencies must give a power of 1 (0 dB)
+    bank.reset();
+
+    for (unsigned int i = 0; i < 256; i++) {
+        pcm[i] = (short) (32767 * sinf(2 * (float) M_PI * frequencies[2] * i / rate));
+    }
+
+    bank.process(pcm, 256);
+
+    printf("Goertzel %u frequencies: %u cycles per frame of %u samples, FFT and front end %u cycles, "
+           "ratio %.1fx, sine power %.3f\r\n", count, goertzelCycles / rounds, size, fftCycles / rounds,
+           (float) fftCycles / goertzelCycles, bank.getPowers()[2]);
+}
+
+
+/**
+ * Compare the multi-resolution analysis with the long FFT alone
+ */
+static void benchmarkMultiResolution() {
+    const unsigned int size = 1024;
+    const unsigned int shortSize = 256;
+    const unsigned int shortFrames = 2;
+    const unsigned int rounds = 8;
+    static short pcm[size];
+
+    HannWindow longWindow(size);
+    HannWindow shortWindow(shortSize);
+    MultiResolutionFFT multiResolution(longWindow, shortWindow, shortFrames, shortSize / 2);
+    FFT fft(size, FFT_REAL);
+    FrontEnd frontEnd(longWindow);
+    unsigned int singleCycles = 0, multiCycles = 0;
+    float maxError = 0;
+
+    for (unsigned int r = 0; r < rounds; r++) {
+        for (unsigned int i = 0; i < size; i++) {
+            pcm[i] = rand() & 0xffffu;
+        }
+
+        unsigned int start = cycleCount();
+        frontEnd.process(pcm, size, fft.getInput());
+        fft.process();
+        unsigned int middle = cycleCount();
+        multiResolution.process(pcm, size);
+        unsigned int end = cycleCount();
+
+        singleCycles += middle - start;
+        multiCycles += end - middle;
+
+        for (unsigned int i = 0; i < size / 2; i++) {
+            float error = fabsf(multiResolution.getFeatures()[i] - fft.getBin(i));
+            maxError = error > maxError ? error : maxError;
+        }
+    }
+
+    printf("Multi-resolution %u + %u x %u: %u cycles, long FFT alone %u cycles, overhead %.1f%%, max error %.2e\r\n",
+           size, shortFrames, shortSize, multiCycles / rounds, singleCycles / rounds,
+           100.0f * (multiCycles - singleCycles) / singleCycles, maxError);
+}
+
+
+/**
+ * Compare the sliding DFT of some bins, updated every hop, with the FFT of the whole frame
+ */
+static void benchmarkSlidingDft() {
+    const unsigned int size = 1024;
+    const unsigned int hop = 256;
+    const unsigned int rounds = 16;
+    const uint16_t bins[] = {25, 26, 27, 28, 29, 30, 31, 32, 50, 51, 52, 53, 54, 55, 56, 57};
+    const unsigned int count = sizeof(bins) / sizeof(bins[0]);
+    static short pcm[size];
+
+    FFT fft(size, FFT_REAL);
+    SlidingDFT sliding(size, bins, count, false);
+    sliding.setResync(&fft, 8 * size);
+    unsigned int slidingCycles = 0, fftCycles = 0;
+    float maxError = 0, maxBin = 0;
+
+    for (unsigned int r = 0; r < rounds; r++) {
+        // Shift the frame by a hop, as the PCM ring does
+        memmove(pcm, pcm + hop, (size - hop) * sizeof(short));
+
+        for (unsigned int i = size - hop; i < size; i++) {
+            pcm[i] = rand() & 0xffffu;
+        }
+
+        unsigned int start = cycleCount();
+        sliding.process(pcm + size - hop, hop);
+        unsigned int middle = cycleCount();
+
+        for (unsigned int i = 0; i < size; i++) {
+            fft.getInput()[i] = pcm[i] * (1.0f / 32768);
+        }
+
+        fft.process();
+        unsigned int end = cycleCount();
+
+        slidingCycles += middle - start;
+        fftCycles += end - middle;
+
+        // The first frames are not full yet
+        if (r >= size / hop) {
+            for (unsigned int i = 0; i < count; i++) {
+                float error = fabsf(sliding.getBins()[i] - fft.getBin(bins[i]));
+                maxError = error > maxError ? error : maxError;
+                maxBin = fft.getBin(bins[i]) > maxBin ? fft.getBin(bins[i]) : maxBin;
+            }
+        }
+    }
+
+    printf("Sliding DFT %u bins: %u cycles per hop of %u samples, FFT %u cycles, ratio %.1fx, max error %.2e\r\n",
+           count, slidingCycles / rounds, hop, fftCycles / rounds, (float) fftCycles / slidingCycles,
+           maxError / maxBin);
+}
+
+
+/**
+ * Check the pitch estimation on synthetic tones, with a harmonic and some noise, and measure
+ * its cost
+ */
+static void benchmarkPitch() {
+    const unsigned int size = 1024;
+    const unsigned int rounds = 64;
+    const float rate = 32000;
+    static short pcm[size];
+
+    FFT fft(size, FFT_REAL);
+    HannWindow window(size);
+    FrontEnd frontEnd(window);
+    PitchEstimator pitch(size, rate);
+    unsigned int cycles = 0, missed = 0;
+    float maxError = 0;
+
+    for (unsigned int r = 0; r < rounds; r++) {
+        // Frequencies not aligned to the bins, from 450 Hz to 3950 Hz
+        float frequency = 450 + 3500.0f * r / rounds + 0.37f * (rand() % 100);
+
+        for (unsigned int i = 0; i < size; i++) {
+            float phase = 2 * (float) M_PI * frequency * i / rate;
+            pcm[i] = (short) (12000 * sinf(phase) + 3000 * sinf(2 * phase) + (rand() % 200) - 100);
+        }
+
+        frontEnd.process(pcm, size, fft.getInput());
+        fft.process();
+
+        unsigned int start = cycleCount();
+        float estimate = pitch.process(fft.getBins());
+        cycles += cycleCount() - start;
+
+        if (estimate == 0) {
+            missed++;
+        } else {
+            float error = fabsf(estimate - frequency);
+            maxError = error > maxError ? error : maxError;
+        }
+    }
+
+    printf("Pitch estimation: %u cycles per frame, max error %.2f Hz (%.3f bins), %u tones missed\r\n",
+           cycles / rounds, maxError, maxError * size / rate, missed);
+}
+
+
+/**
+ * Measure the cost of the feature normalization, while updating the statistics and when frozen,
+ * and check that the result doesn't depend on the gain of the input
+ */
+static void benchmarkNormalization() {
+    const unsigned int size = 512;
+    const unsigned int rounds = 64;
+    const float gain = 20;
+    static float features[size], scaled[size], output[size], scaledOutput[size];
+
+    FeatureNormalizer normalizer(size), scaledNormalizer(size);
+    unsigned int updateCycles = 0, frozenCycles = 0;
+    float maxDifference = 0;
+
+    for (unsigned int r = 0; r < 2 * rounds; r++) {
+        for (unsigned int i = 0; i < size; i++) {
+            features[i] = (float) (rand() % 1000) / 100 + i * 0.01f;
+            scaled[i] = features[i] * gain;
+        }
+
+        if (r == rounds) {
+            normalizer.setFrozen(true);
+            scaledNormalizer.setFrozen(true);
+        }
+
+        unsigned int start = cycleCount();
+        normalizer.process(features, output);
+        unsigned int cycles = cycleCount() - start;
+        scaledNormalizer.process(scaled, scaledOutput);
+
+        if (r < rounds) {
+            updateCycles += cycles;
+        } else {
+            frozenCycles += cycles;
+        }
+
+        for (unsigned int i = 0; i < size; i++) {
+            float difference = fabsf(output[i] - scaledOutput[i]);
+            maxDifference = difference > maxDifference ? difference : maxDifference;
+        }
+    }
+
+    printf("Normalization %u features: %u cycles per frame, %u when frozen, max difference with gain %.0f %.2e\r\n",
+           size, updateCycles / rounds, frozenCycles / rounds, gain, maxDifference);
+}
+
+
+/**
+ * Measure the cost of appending a frame to the spectrogram, for each layout and storage type
+ */
+template<typename T>
+static void benchmarkSpectrogram(const char *name, SpectrogramLayout layout) {
+    const unsigned int bins = 512;
+    const unsigned int frames = 8;
+    const unsigned int rounds = 64;
+    static float values[bins];
+
+    Spectrogram<T> spectrogram(bins, frames, layout);
+    unsigned int cycles = 0;
+    float maxError = 0;
+
+    for (unsigned int r = 0; r < rounds; r++) {
+        for (unsigned int i = 0; i < bins; i++) {
+            values[i] = (float) (rand() % 2000) / 10 - 100;
+        }
+
+        unsigned int start = cycleCount();
+        spectrogram.push(values);
+        cycles += cycleCount() - start;
+
+        for (unsigned int i = 0; i < bins; i++) {
+            float error = fabsf(spectrogram.getValue(frames - 1, i) - values[i]);
+            maxError = error > maxError ? error : maxError;
+        }
+    }
+
+    printf("Spectrogram %u x %u %s: %u cycles per frame, max error %.2e\r\n",
+           frames, bins, name, cycles / rounds, maxError);
+}
+
+
+void runBenchmarks() {
+    cycleCounterInit();
+    benchmarkCic();
+    benchmarkFft();
+    benchmarkFftOutput();
+    benchmarkFrontEnd();
+    benchmarkGoertzel();
+    benchmarkMultiResolution();
+    benchmarkSlidingDft();
+    benchmarkPitch();
+    benchmarkNormalization();
+    benchmarkSpectrogram<float>("float time-major", SPECTROGRAM_TIME_MAJOR);
+    benchmarkSpectrogram<float>("float frequency-major", SPECTROGRAM_FREQUENCY_MAJOR);
+    benchmarkSpectrogram<Half>("half time-major", SPECTROGRAM_TIME_MAJOR);
+}
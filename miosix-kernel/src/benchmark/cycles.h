@@ -0,0 +1,61 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef CYCLES_H
+#define CYCLES_H
+
+/**
+ * Cycle counter used to profile the signal processing stages.
+ * On the board the DWT cycle counter of the core is used; when compiled for the host the
+ * count is expressed in nanoseconds.
+ */
+#ifdef _MIOSIX
+
+#include <interfaces/arch_registers.h>
+
+/**
+ * Enable and reset the cycle counter.
+ */
+inline void cycleCounterInit() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * Get the current value of the cycle counter.
+ * The counter is 32 bit wide and wraps around, so only differences are meaningful.
+ */
+inline unsigned int cycleCount() {
+    return DWT->CYCCNT;
+}
+
+#else
+
+#include <chrono>
+
+inline void cycleCounterInit() {
+}
+
+inline unsigned int cycleCount() {
+    using namespace std::chrono;
+    return (unsigned int) duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
+
+#endif /* CYCLES_H */
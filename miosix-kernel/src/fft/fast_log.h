@@ -0,0 +1,74 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef FAST_LOG_H
+#define FAST_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Power corresponding to the lowest value given by powerToDb (-120 dB), to avoid the
+ * logarithm of 0 on silent bins.
+ */
+#define POWER_FLOOR 1e-12f
+
+
+/**
+ * Approximate base 2 logarithm, with an absolute error below 8e-4.
+ * The exponent of the float is taken as it is, and the logarithm of the mantissa is
+ * approximated with a cubic polynomial. Only valid for positive normal numbers.
+ *
+ * @param value     argument of the logarithm
+ * @return logarithm
+ */
+inline float fastLog2(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    // value = 2^exponent * (1 + t), with t in [0, 1)
+    int exponent = (int) ((bits >> 23) & 0xff) - 127;
+    bits = (bits & 0x7fffff) | 0x3f800000;
+
+    float t;
+    memcpy(&t, &bits, sizeof(t));
+    t -= 1.0f;
+
+    return exponent + t * (1.4245946f + t * (-0.5892098f + t * 0.1653866f));
+}
+
+
+/**
+ * Convert a block of powers to decibels, with the fast logarithm.
+ * The error is below 0.003 dB. Powers below POWER_FLOOR are clamped to it.
+ *
+ * @param input     powers
+ * @param output    destination, which can be the same as the input
+ * @param n         number of values
+ */
+inline void powerToDb(const float* input, float* output, size_t n) {
+    // 10 * log10(x) = 10 * log10(2) * log2(x)
+    const float scale = 3.0103000f;
+
+    for (size_t i = 0; i < n; i++) {
+        float value = input[i] > POWER_FLOOR ? input[i] : POWER_FLOOR;
+        output[i] = scale * fastLog2(value);
+    }
+}
+
+#endif /* FAST_LOG_H */
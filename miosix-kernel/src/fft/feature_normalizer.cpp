@@ -0,0 +1,156 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "feature_normalizer.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _MIOSIX
+#include "fft.h"
+#endif
+
+using namespace std;
+
+
+FeatureNormalizer::FeatureNormalizer(size_t size, float adaptation, float minVariance)
+        : size(size), adaptation(adaptation), minVariance(minVariance) {
+
+    if (size == 0 || adaptation <= 0 || adaptation > 1 || minVariance <= 0) {
+        throw invalid_argument("Invalid normalization parameters");
+    }
+
+    mean = (float*) malloc(3 * size * sizeof(float));
+
+    if (!mean) {
+        throw runtime_error("Normalization statistics allocation failed");
+    }
+
+    variance = mean + size;
+    scale = variance + size;
+
+    reset();
+}
+
+
+FeatureNormalizer::~FeatureNormalizer() {
+    free(mean);
+}
+
+
+void FeatureNormalizer::process(const float *input, float *output, bool update) {
+    if (frozen || !update) {
+        #ifdef _MIOSIX
+            arm_sub_f32(const_cast<float*>(input), mean, output, size);
+            arm_mult_f32(output, scale, output, size);
+        #else
+            for (size_t i = 0; i < size; i++) {
+                output[i] = (input[i] - mean[i]) * scale[i];
+            }
+        #endif
+
+        return;
+    }
+
+    // Plain average of the first frames, then exponential
+    float weight = 1.0f / (frames + 1);
+    weight = weight > adaptation ? weight : adaptation;
+    frames++;
+
+    // With d = x - mean, the new mean is mean + w d, the new variance (1 - w) (variance + w d^2),
+    // and the normalized feature (x - new mean) / deviation = (1 - w) d / deviation
+    #ifdef _MIOSIX
+        arm_sub_f32(const_cast<float*>(input), mean, output, size);
+        arm_mult_f32(output, output, scale, size);
+        arm_scale_f32(scale, weight, scale, size);
+        arm_add_f32(variance, scale, variance, size);
+        arm_scale_f32(variance, 1 - weight, variance, size);
+        arm_scale_f32(output, weight, scale, size);
+        arm_add_f32(mean, scale, mean, size);
+        updateScale();
+        arm_mult_f32(output, scale, output, size);
+        arm_scale_f32(output, 1 - weight, output, size);
+    #else
+        for (size_t i = 0; i < size; i++) {
+            float difference = input[i] - mean[i];
+            mean[i] += weight * difference;
+            variance[i] = (1 - weight) * (variance[i] + weight * difference * difference);
+            output[i] = difference;
+        }
+
+        updateScale();
+
+        for (size_t i = 0; i < size; i++) {
+            output[i] *= (1 - weight) * scale[i];
+        }
+    #endif
+}
+
+
+void FeatureNormalizer::updateScale() {
+    for (size_t i = 0; i < size; i++) {
+        float value = variance[i] > minVariance ? variance[i] : minVariance;
+        scale[i] = 1.0f / sqrtf(value);
+    }
+}
+
+
+void FeatureNormalizer::setFrozen(bool frozen) {
+    this->frozen = frozen;
+}
+
+
+bool FeatureNormalizer::isFrozen() {
+    return frozen;
+}
+
+
+void FeatureNormalizer::setStatistics(const float *mean, const float *variance) {
+    memcpy(this->mean, mean, size * sizeof(float));
+    memcpy(this->variance, variance, size * sizeof(float));
+    updateScale();
+    frozen = true;
+}
+
+
+void FeatureNormalizer::reset() {
+    memset(mean, 0, 2 * size * sizeof(float));
+    updateScale();
+    frozen = false;
+    frames = 0;
+}
+
+
+const float* FeatureNormalizer::getMean() {
+    return mean;
+}
+
+
+const float* FeatureNormalizer::getVariance() {
+    return variance;
+}
+
+
+unsigned int FeatureNormalizer::getFrames() {
+    return frames;
+}
+
+
+size_t FeatureNormalizer::getSize() {
+    return size;
+}
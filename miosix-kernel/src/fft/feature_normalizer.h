@@ -0,0 +1,146 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef FEATURE_NORMALIZER_H
+#define FEATURE_NORMALIZER_H
+
+#include <cstddef>
+
+/**
+ * Normalization of the features to zero mean and unit variance, bin by bin, with running
+ * statistics, so that the network input doesn't depend on the gain and the distance of the
+ * microphone.
+ *
+ * The mean and the variance are exponentially weighted averages, updated in place at each frame.
+ * At the beginning the weight of each frame is 1 / frames, so that the statistics are the plain
+ * averages until the exponential ones take over. The statistics can be frozen, for example
+ * after a calibration, or loaded from the ones of the training set.
+ *
+ * All the buffers are allocated by the constructor. On the board the update uses the CMSIS-DSP
+ * vector functions.
+ */
+class FeatureNormalizer {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param size          number of features
+     * @param adaptation    weight of each new frame in the statistics (1 / time constant in frames)
+     * @param minVariance   lower bound of the variance, to avoid amplifying the constant features
+     */
+    explicit FeatureNormalizer(size_t size, float adaptation = 0.01f, float minVariance = 1e-6f);
+
+
+    /**
+     * Destructor.
+     * Frees the statistics.
+     */
+    ~FeatureNormalizer();
+
+
+    /**
+     * Update the statistics with a frame, unless frozen, and normalize it.
+     *
+     * @param input     features
+     * @param output    normalized features (can be the same buffer as the input)
+     * @param update    false to normalize the frame without adding it to the statistics
+     */
+    void process(const float *input, float *output, bool update = true);
+
+
+    /**
+     * Stop or restart the update of the statistics
+     *
+     * @param frozen    true to use the current statistics without updating them
+     */
+    void setFrozen(bool frozen);
+
+
+    /**
+     * Check whether the statistics are frozen
+     *
+     * @return true if frozen
+     */
+    bool isFrozen();
+
+
+    /**
+     * Replace the statistics, for example with the ones of the training set, and freeze them
+     *
+     * @param mean          mean of each feature
+     * @param variance      variance of each feature
+     */
+    void setStatistics(const float *mean, const float *variance);
+
+
+    /**
+     * Forget the statistics and unfreeze them
+     */
+    void reset();
+
+
+    /**
+     * Get the mean of each feature
+     *
+     * @return size values
+     */
+    const float* getMean();
+
+
+    /**
+     * Get the variance of each feature
+     *
+     * @return size values
+     */
+    const float* getVariance();
+
+
+    /**
+     * Get the number of frames used to update the statistics
+     *
+     * @return number of frames
+     */
+    unsigned int getFrames();
+
+
+    /**
+     * Get the number of features
+     *
+     * @return number of features
+     */
+    size_t getSize();
+
+
+private:
+    /**
+     * Compute the inverse of the standard deviations
+     */
+    void updateScale();
+
+    size_t size;
+    float adaptation;
+    float minVariance;
+    bool frozen;
+    unsigned int frames;
+
+    float *mean;
+    float *variance;
+    float *scale;       // 1 / standard deviation, also used as scratch during the update
+};
+
+#endif /* FEATURE_NORMALIZER_H */
@@ -16,6 +16,7 @@
  **************************************************************************/
 
 #include "fft.h"
+#include "fast_log.h"
 #include <stdexcept>
 #include <stdlib.h>
 #include <CMSIS/Include/arm_const_structs.h>
@@ -39,7 +40,8 @@ const arm_cfft_instance_f32 CFFT_Instances[] = {
 };
 
 
-FFT::FFT(uint16_t windowSize) {
+FFT::FFT(uint16_t windowSize, FftMode mode, FftOutput outputType)
+        : mode(mode), outputType(outputType), spectrum(nullptr) {
     // Check for proper window size value
     size = 0;
 
@@ -52,27 +54,40 @@ FFT::FFT(uint16_t windowSize) {
         }
     }
 
-    if (size == 0) {
+    if (size == 0 || (mode == FFT_REAL && arm_rfft_fast_init_f32(&rfft, size) != ARM_MATH_SUCCESS)) {
         // Invalid window size
         throw invalid_argument("Invalid FFT size");
     }
 
     // Initially there are no samples
     count = 0;
+    sampleRate = 0;
 
-    // Allocate input buffer. Its size is 2 * windowSize because each sample is composed by real
-    // and imaginary part. The imaginary part is automatically set to 0 when adding the samples.
-    input = (float32_t*) malloc((size * 2) * sizeof(float32_t));
+    // Allocate input buffer. The samples are real, but in complex mode its size is
+    // 2 * windowSize because the complex FFT is computed in place. The imaginary parts are
+    // set to 0 just before the processing.
+    input = (float32_t*) malloc((mode == FFT_REAL ? size : size * 2) * sizeof(float32_t));
 
     if (!input) {
         throw runtime_error("Input buffer allocation failed");
     }
 
+    // Allocate the buffer for the real FFT output, which can't be computed in place
+    if (mode == FFT_REAL) {
+        spectrum = (float32_t*) malloc(size * sizeof(float32_t));
+
+        if (!spectrum) {
+            free(this->input);
+            throw runtime_error("Spectrum buffer allocation failed");
+        }
+    }
+
     // Allocate output buffer
-    output = (float32_t*) malloc(size * sizeof(float32_t));
+    output = (float32_t*) malloc(size / 2 * sizeof(float32_t));
 
     if (!output) {
         free(this->input);
+        free(this->spectrum);
         throw runtime_error("Output buffer allocation failed");
     }
 }
@@ -83,6 +98,10 @@ FFT::~FFT() {
         free(input);
     }
 
+    if (spectrum) {
+        free(spectrum);
+    }
+
     if (output) {
         free(output);
     }
@@ -92,11 +111,8 @@ FFT::~FFT() {
 bool FFT::addSample(float32_t value) {
     // Check if memory available
     if (count < size) {
-        // Add to buffer, real part
-        input[2 * count] = value;
-
-        // Imaginary part set to 0
-        input[2 * count + 1] = 0;
+        // Add to buffer
+        input[count] = value;
 
         // Increase count
         count++;
@@ -108,17 +124,49 @@ bool FFT::addSample(float32_t value) {
 
 
 void FFT::process() {
-    // Process input data
-    arm_cfft_f32(s, input, 0, 1);
+    if (mode == FFT_REAL) {
+        arm_rfft_fast_f32(&rfft, input, spectrum, 0);
+
+        // The first two values are the real parts of the DC and Nyquist bins. Only the DC is kept.
+        if (outputType == FFT_MAGNITUDE) {
+            output[0] = fabsf(spectrum[0]);
+            arm_cmplx_mag_f32(spectrum + 2, output + 1, size / 2 - 1);
+        } else {
+            output[0] = spectrum[0] * spectrum[0];
+            arm_cmplx_mag_squared_f32(spectrum + 2, output + 1, size / 2 - 1);
+        }
 
-    // Process the data through the Complex Magnitude Module for calculating the magnitude at each bin
-    arm_cmplx_mag_f32(input, output, size);
+    } else {
+        // Convert the samples to complex numbers, starting from the last one to work in place
+        for (uint32_t i = size; i-- > 0;) {
+            input[2 * i] = input[i];
+            input[2 * i + 1] = 0;
+        }
+
+        arm_cfft_f32(s, input, 0, 1);
+
+        // Process the data through the Complex Magnitude Module for calculating the magnitude at each bin
+        if (outputType == FFT_MAGNITUDE) {
+            arm_cmplx_mag_f32(input, output, size / 2);
+        } else {
+            arm_cmplx_mag_squared_f32(input, output, size / 2);
+        }
+    }
+
+    if (outputType == FFT_LOG_POWER) {
+        powerToDb(output, output, size / 2);
+    }
 
     // Reset count
     count = 0;
 }
 
 
+float32_t* FFT::getInput() {
+    return input;
+}
+
+
 uint16_t FFT::getSize() {
     return size;
 }
@@ -132,3 +180,30 @@ const float32_t* FFT::getBins() {
 float32_t FFT::getBin(uint16_t index) {
     return output[index];
 }
+
+
+void FFT::getComplexBin(uint16_t index, float32_t &real, float32_t &imaginary) {
+    if (mode == FFT_COMPLEX) {
+        real = input[2 * index];
+        imaginary = input[2 * index + 1];
+
+    } else if (index == 0 || index == size / 2) {
+        // The DC and Nyquist bins are real, packed in the first two values
+        real = spectrum[index == 0 ? 0 : 1];
+        imaginary = 0;
+
+    } else {
+        real = spectrum[2 * index];
+        imaginary = spectrum[2 * index + 1];
+    }
+}
+
+
+void FFT::setSampleRate(float32_t rate) {
+    sampleRate = rate;
+}
+
+
+float32_t FFT::getBinFrequency(uint16_t index) {
+    return index * sampleRate / size;
+}
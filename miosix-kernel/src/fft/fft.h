@@ -53,6 +53,16 @@
 
 #include <interfaces/arch_registers.h>
 #include <CMSIS/Include/arm_math.h>
+#include "fft_output.h"
+
+/**
+ * FFT algorithms. Both give the same magnitudes.
+ */
+typedef enum {
+    FFT_COMPLEX,    // Complex FFT of length N, with zero imaginary parts
+    FFT_REAL        // Real FFT: complex FFT of length N/2 followed by a split step (N >= 32)
+} FftMode;
+
 
 class FFT {
 public:
@@ -61,8 +71,10 @@ public:
      * Constructor
      *
      * @param windowSize    number of samples to be used for FFT calculation
+     * @param mode          algorithm to be used
+     * @param outputType    values to be computed for each bin
      */
-    explicit FFT(uint16_t windowSize);
+    explicit FFT(uint16_t windowSize, FftMode mode = FFT_COMPLEX, FftOutput outputType = FFT_MAGNITUDE);
 
 
     /**
@@ -82,6 +94,15 @@ public:
     bool addSample(float32_t value);
 
 
+    /**
+     * Get the input buffer, to be filled with windowSize real samples before calling process.
+     * It is an alternative to addSample, for stages working on whole frames.
+     *
+     * @return input buffer
+     */
+    float32_t* getInput();
+
+
     /**
      * Process and calculate FFT from the input buffer and store the data in the output buffer.
      */
@@ -98,8 +119,9 @@ public:
 
     /**
      * Get the array of the output bins.
+     * Only the first half of the spectrum is computed, as the other one is symmetric.
      *
-     * @return output buffer
+     * @return output buffer of windowSize / 2 values, of the type chosen in the constructor
      */
     const float32_t* getBins();
 
@@ -113,12 +135,44 @@ public:
     float32_t getBin(uint16_t index);
 
 
+    /**
+     * Get the complex value of a bin, as computed by the last process call.
+     *
+     * @param index         bin index, from 0 to windowSize / 2 (included)
+     * @param real          real part
+     * @param imaginary     imaginary part
+     */
+    void getComplexBin(uint16_t index, float32_t &real, float32_t &imaginary);
+
+
+    /**
+     * Set the sample rate of the input, used to map the bins to frequencies.
+     *
+     * @param rate      sample rate in Hz
+     */
+    void setSampleRate(float32_t rate);
+
+
+    /**
+     * Get the center frequency of a bin.
+     *
+     * @param index     index of the output buffer
+     * @return frequency in Hz
+     */
+    float32_t getBinFrequency(uint16_t index);
+
+
 private:
     uint16_t size;                      // Window size in units of samples. This parameter should be a value of 2^n, where n must between 4 and 12.
-    float32_t* input;                   // Data input buffer. Its length is 2 * windowSize.
-    float32_t* output;                  // Data output buffer. Its length is windowSize.
+    FftMode mode;                       // Algorithm
+    FftOutput outputType;               // Values of the output bins
+    float32_t* input;                   // Data input buffer. Its length is 2 * windowSize in complex mode and windowSize in real mode.
+    float32_t* spectrum;                // Packed output of the real FFT. Its length is windowSize (real mode only).
+    float32_t* output;                  // Data output buffer. Its length is windowSize / 2.
     const arm_cfft_instance_f32* s;     // Pointer to arm_cfft_instance_f32 structure.
+    arm_rfft_fast_instance_f32 rfft;    // Real FFT instance (real mode only).
     uint32_t count;                     // Number of samples in input buffer.
+    float32_t sampleRate;               // Sample rate of the input, in Hz.
 };
 
 #endif /* FFT_H */
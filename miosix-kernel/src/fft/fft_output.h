@@ -0,0 +1,30 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef FFT_OUTPUT_H
+#define FFT_OUTPUT_H
+
+/**
+ * Values stored in the output bins
+ */
+typedef enum {
+    FFT_MAGNITUDE,  // Magnitude
+    FFT_POWER,      // Squared magnitude, which doesn't need a square root for each bin
+    FFT_LOG_POWER   // Power in dB, computed with a fast approximation of the logarithm (see fast_log.h)
+} FftOutput;
+
+#endif /* FFT_OUTPUT_H */
@@ -0,0 +1,289 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "fixed_fft.h"
+#include "fast_log.h"
+#include <stdexcept>
+#include <stdlib.h>
+#include <CMSIS/Include/arm_const_structs.h>
+
+
+using namespace std;
+
+
+/* CFFT instances, from 16 to 4096 points */
+static const arm_cfft_instance_q15* const CFFT_Instances_q15[] = {
+        &arm_cfft_sR_q15_len16, &arm_cfft_sR_q15_len32, &arm_cfft_sR_q15_len64,
+        &arm_cfft_sR_q15_len128, &arm_cfft_sR_q15_len256, &arm_cfft_sR_q15_len512,
+        &arm_cfft_sR_q15_len1024, &arm_cfft_sR_q15_len2048, &arm_cfft_sR_q15_len4096
+};
+
+static const arm_cfft_instance_q31* const CFFT_Instances_q31[] = {
+        &arm_cfft_sR_q31_len16, &arm_cfft_sR_q31_len32, &arm_cfft_sR_q31_len64,
+        &arm_cfft_sR_q31_len128, &arm_cfft_sR_q31_len256, &arm_cfft_sR_q31_len512,
+        &arm_cfft_sR_q31_len1024, &arm_cfft_sR_q31_len2048, &arm_cfft_sR_q31_len4096
+};
+
+
+/*
+ * CMSIS functions for each sample type
+ */
+static const arm_cfft_instance_q15* getInstance(q15_t*, unsigned int index) {
+    return CFFT_Instances_q15[index];
+}
+
+static const arm_cfft_instance_q31* getInstance(q31_t*, unsigned int index) {
+    return CFFT_Instances_q31[index];
+}
+
+static void multiply(q15_t* data, q15_t* coefficients, uint32_t n) {
+    arm_mult_q15(data, coefficients, data, n);
+}
+
+static void multiply(q31_t* data, q31_t* coefficients, uint32_t n) {
+    arm_mult_q31(data, coefficients, data, n);
+}
+
+static void shift(q15_t* data, int8_t bits, uint32_t n) {
+    arm_shift_q15(data, bits, data, n);
+}
+
+static void shift(q31_t* data, int8_t bits, uint32_t n) {
+    arm_shift_q31(data, bits, data, n);
+}
+
+static void transform(const arm_cfft_instance_q15* s, q15_t* data) {
+    arm_cfft_q15(s, data, 0, 1);
+}
+
+static void transform(const arm_cfft_instance_q31* s, q31_t* data) {
+    arm_cfft_q31(s, data, 0, 1);
+}
+
+static void magnitude(q15_t* data, q15_t* output, uint32_t n) {
+    arm_cmplx_mag_q15(data, output, n);
+}
+
+static void magnitude(q31_t* data, q31_t* output, uint32_t n) {
+    arm_cmplx_mag_q31(data, output, n);
+}
+
+
+template<typename T>
+FixedFFT<T>::FixedFFT(uint16_t windowSize, WindowFunction* window, FftOutput outputType)
+        : coefficients(nullptr), outputType(outputType) {
+    // Check for proper window size value
+    size = 0;
+
+    for (unsigned int i = 0; i < 9; i++) {
+        if (windowSize == 16u << i) {
+            // Valid window size found. Save the reference to CFFT instance
+            size = windowSize;
+            sizeBits = i + 4;
+            s = getInstance((T*) nullptr, i);
+            break;
+        }
+    }
+
+    if (size == 0 || (window && window->getSize() != size)) {
+        // Invalid window size
+        throw invalid_argument("Invalid FFT size");
+    }
+
+    // Initially there are no samples
+    count = 0;
+    exponent = 0;
+    sampleRate = 0;
+
+    // Allocate input buffer. The samples are real, but its size is 2 * windowSize because
+    // the complex FFT is computed in place.
+    input = (T*) malloc(size * 2 * sizeof(T));
+
+    if (!input) {
+        throw runtime_error("Input buffer allocation failed");
+    }
+
+    // Allocate output buffer
+    output = (T*) malloc(size / 2 * sizeof(T));
+
+    if (!output) {
+        free(this->input);
+        throw runtime_error("Output buffer allocation failed");
+    }
+
+    // Convert the window coefficients, saturating the ones equal to 1
+    if (window) {
+        coefficients = (T*) malloc(size * sizeof(T));
+
+        if (!coefficients) {
+            free(this->input);
+            free(this->output);
+            throw runtime_error("Window coefficients allocation failed");
+        }
+
+        const double fullScale = 1ull << FixedFftTraits<T>::fractionalBits;
+        const float *values = window->getCoefficients();
+
+        for (uint32_t i = 0; i < size; i++) {
+            double value = values[i] * fullScale + 0.5;
+            coefficients[i] = value < fullScale - 1 ? (T) value : (T) (fullScale - 1);
+        }
+    }
+}
+
+
+template<typename T>
+FixedFFT<T>::~FixedFFT() {
+    if (input) {
+        free(input);
+    }
+
+    if (output) {
+        free(output);
+    }
+
+    if (coefficients) {
+        free(coefficients);
+    }
+}
+
+
+template<typename T>
+bool FixedFFT<T>::addSample(T value) {
+    // Check if memory available
+    if (count < size) {
+        // Add to buffer
+        input[count] = value;
+
+        // Increase count
+        count++;
+    }
+
+    // Check if buffer full
+    return count >= size;
+}
+
+
+template<typename T>
+void FixedFFT<T>::process() {
+    const int fractionalBits = FixedFftTraits<T>::fractionalBits;
+
+    // Find the peak of the frame, to shift it up to the full scale. The window is applied
+    // after the shift, so that its rounding doesn't depend on the level of the input.
+    uint32_t peak = 0;
+
+    for (uint32_t i = 0; i < size; i++) {
+        uint32_t value = input[i] < 0 ? -(uint32_t) input[i] : input[i];
+        peak = value > peak ? value : peak;
+    }
+
+    int bits = 0;
+
+    if (peak > 0) {
+        while (bits < fractionalBits - 1 && peak < (1ul << (fractionalBits - 1 - bits))) {
+            bits++;
+        }
+    }
+
+    shift(input, bits, size);
+
+    if (coefficients) {
+        multiply(input, coefficients, size);
+    }
+
+    // Convert the samples to complex numbers, starting from the last one to work in place
+    for (uint32_t i = size; i-- > 0;) {
+        input[2 * i] = input[i];
+        input[2 * i + 1] = 0;
+    }
+
+    // The FFT output is divided by the size, the magnitudes have one integer bit more
+    transform(s, input);
+    magnitude(input, output, size / 2);
+    exponent = sizeBits - bits - (fractionalBits - 1);
+
+    // Reset count
+    count = 0;
+}
+
+
+template<typename T>
+T* FixedFFT<T>::getInput() {
+    return input;
+}
+
+
+template<typename T>
+uint16_t FixedFFT<T>::getSize() {
+    return size;
+}
+
+
+template<typename T>
+const T* FixedFFT<T>::getBins() {
+    return output;
+}
+
+
+template<typename T>
+T FixedFFT<T>::getBin(uint16_t index) {
+    return output[index];
+}
+
+
+template<typename T>
+int FixedFFT<T>::getExponent() {
+    return exponent;
+}
+
+
+template<typename T>
+void FixedFFT<T>::getFeatures(float32_t* features) {
+    const float32_t scale = ldexpf(1.0f, exponent);
+
+    if (outputType == FFT_MAGNITUDE) {
+        for (uint32_t i = 0; i < size / 2u; i++) {
+            features[i] = output[i] * scale;
+        }
+
+    } else {
+        for (uint32_t i = 0; i < size / 2u; i++) {
+            float32_t value = output[i] * scale;
+            features[i] = value * value;
+        }
+
+        if (outputType == FFT_LOG_POWER) {
+            powerToDb(features, features, size / 2);
+        }
+    }
+}
+
+
+template<typename T>
+void FixedFFT<T>::setSampleRate(float32_t rate) {
+    sampleRate = rate;
+}
+
+
+template<typename T>
+float32_t FixedFFT<T>::getBinFrequency(uint16_t index) {
+    return index * sampleRate / size;
+}
+
+
+template class FixedFFT<q15_t>;
+template class FixedFFT<q31_t>;
@@ -0,0 +1,179 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef FIXED_FFT_H
+#define FIXED_FFT_H
+
+#include "fft.h"
+#include "window.h"
+
+/**
+ * Types and formats of the CMSIS fixed point FFTs
+ */
+template<typename T>
+struct FixedFftTraits;
+
+template<>
+struct FixedFftTraits<q15_t> {
+    typedef arm_cfft_instance_q15 Instance;
+    static const int fractionalBits = 15;
+};
+
+template<>
+struct FixedFftTraits<q31_t> {
+    typedef arm_cfft_instance_q31 Instance;
+    static const int fractionalBits = 31;
+};
+
+
+/**
+ * Fixed point FFT.
+ * Instantiated for q15_t and q31_t samples: q15_t takes the least memory, while q31_t gives a
+ * dynamic range close to the float one. The memory saving is small, as the transform is complex
+ * and in place: with q15_t the buffers take 7 bytes per sample (a 2 * windowSize input, a
+ * windowSize / 2 output and the window coefficients), against the 10 of the float FFT in real
+ * mode, whose window is read from the flash table.
+ *
+ * The CMSIS FFT scales its output down by the FFT size to avoid overflows. To keep the
+ * precision, each frame is shifted left before the transform to fill the whole range, and the
+ * exponent of the block is tracked: the magnitude of bin i is getBin(i) * 2^getExponent(),
+ * in the same units of the float FFT fed with samples in [-1, 1).
+ *
+ * The bins are always magnitudes, as the squared magnitudes in fixed point would keep only
+ * half of the dynamic range. The powers and their logarithms are computed by getFeatures.
+ */
+template<typename T>
+class FixedFFT {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param windowSize    number of samples to be used for FFT calculation
+     * @param window        window function to be applied to the input, or nullptr to disable
+     *                      it. Its coefficients are converted and copied, so it can be destroyed
+     *                      after the construction.
+     * @param outputType    values to be given by getFeatures
+     */
+    explicit FixedFFT(uint16_t windowSize, WindowFunction* window = nullptr, FftOutput outputType = FFT_MAGNITUDE);
+
+
+    /**
+     * Destructor.
+     * Frees the buffers.
+     */
+    ~FixedFFT();
+
+
+    /**
+     * Add a new sample to the input buffer
+     *
+     * @param value     value to be added
+     * @return true if the input buffer is full and samples are ready to be processed;
+     *         false if the input buffer is not full yet
+     */
+    bool addSample(T value);
+
+
+    /**
+     * Get the input buffer, to be filled with windowSize real samples before calling process.
+     * With q15_t samples the PCM frames can be copied as they are.
+     *
+     * @return input buffer
+     */
+    T* getInput();
+
+
+    /**
+     * Window the input buffer, calculate the FFT and store the magnitudes in the output buffer.
+     */
+    void process();
+
+
+    /**
+     * Get FFT size in units of samples length.
+     *
+     * @return window size
+     */
+    uint16_t getSize();
+
+
+    /**
+     * Get the array of the output bins, without the block exponent.
+     *
+     * @return output buffer of windowSize / 2 magnitudes
+     */
+    const T* getBins();
+
+
+    /**
+     * Get value of a specific bin, without the block exponent.
+     *
+     * @param index     index of the output buffer
+     * @return bin value
+     */
+    T getBin(uint16_t index);
+
+
+    /**
+     * Get the exponent of the last processed frame.
+     *
+     * @return power of two to be applied to the bins to get the magnitudes
+     */
+    int getExponent();
+
+
+    /**
+     * Convert the bins of the last processed frame to the values given by the float FFT with
+     * the same output type, which are the features expected by the neural network.
+     *
+     * @param features  destination of windowSize / 2 values
+     */
+    void getFeatures(float32_t* features);
+
+
+    /**
+     * Set the sample rate of the input, used to map the bins to frequencies.
+     *
+     * @param rate      sample rate in Hz
+     */
+    void setSampleRate(float32_t rate);
+
+
+    /**
+     * Get the center frequency of a bin.
+     *
+     * @param index     index of the output buffer
+     * @return frequency in Hz
+     */
+    float32_t getBinFrequency(uint16_t index);
+
+
+private:
+    uint16_t size;                      // Window size in units of samples (2^n, with n between 4 and 12)
+    uint16_t sizeBits;                  // Base 2 logarithm of the window size
+    T* input;                           // Data input buffer. Its length is 2 * windowSize, as the FFT is computed in place.
+    T* output;                          // Data output buffer. Its length is windowSize / 2.
+    T* coefficients;                    // Window coefficients, or nullptr if the window is disabled
+    FftOutput outputType;               // Values of the features
+    const typename FixedFftTraits<T>::Instance* s;  // CMSIS instance for the window size
+    uint32_t count;                     // Number of samples in input buffer
+    int exponent;                       // Block exponent of the last processed frame
+    float32_t sampleRate;               // Sample rate of the input, in Hz
+};
+
+#endif /* FIXED_FFT_H */
@@ -0,0 +1,102 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "front_end.h"
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _MIOSIX
+#include "fft.h"
+#endif
+
+using namespace std;
+
+
+FrontEnd::FrontEnd(WindowFunction &window) : size(window.getSize()) {
+    allocated = (float*) malloc(size * sizeof(float));
+
+    if (!allocated) {
+        throw runtime_error("Window coefficients allocation failed");
+    }
+
+    // The CMSIS conversion already divides by 32768
+    #ifdef _MIOSIX
+        const float scale = 1.0f;
+    #else
+        const float scale = 1.0f / 32768;
+    #endif
+
+    const float *values = window.getCoefficients();
+
+    for (size_t i = 0; i < size; i++) {
+        allocated[i] = values[i] * scale;
+    }
+
+    coefficients = allocated;
+}
+
+
+FrontEnd::FrontEnd(const float *window, size_t size) : size(size) {
+    #ifdef _MIOSIX
+        // The CMSIS conversion already normalizes the samples, so the table is used as it is
+        coefficients = window;
+        allocated = nullptr;
+    #else
+        allocated = (float*) malloc(size * sizeof(float));
+
+        if (!allocated) {
+            throw runtime_error("Window coefficients allocation failed");
+        }
+
+        for (size_t i = 0; i < size; i++) {
+            allocated[i] = window[i] / 32768;
+        }
+
+        coefficients = allocated;
+    #endif
+}
+
+
+FrontEnd::~FrontEnd() {
+    free(allocated);
+}
+
+
+void FrontEnd::process(const short *pcm, size_t n, float *output) {
+    if (n > size)
+        n = size;
+
+    #ifdef _MIOSIX
+        arm_q15_to_float(const_cast<q15_t*>(pcm), output, n);
+        arm_mult_f32(output, const_cast<float*>(coefficients), output, n);
+    #else
+        for (size_t i = 0; i < n; i++) {
+            output[i] = pcm[i] * coefficients[i];
+        }
+    #endif
+
+    // If the data is not enough, fill with zeros
+    if (n < size) {
+        memset(output + n, 0, (size - n) * sizeof(float));
+    }
+}
+
+
+size_t FrontEnd::getSize() {
+    return size;
+}
@@ -0,0 +1,88 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef FRONT_END_H
+#define FRONT_END_H
+
+#include <cstddef>
+#include "window.h"
+
+/**
+ * First stage of the spectral analysis: converts a frame of 16 bit PCM samples to float,
+ * normalizes it to [-1, 1) and applies the window function, writing the result into the
+ * FFT input buffer.
+ *
+ * The whole frame is processed in a single call. On the board the CMSIS-DSP vector
+ * functions are used; elsewhere a portable loop with the normalization folded into the window
+ * coefficients.
+ */
+class FrontEnd {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param window    window function. Its coefficients are copied, so it can be destroyed
+     *                  after the construction.
+     */
+    explicit FrontEnd(WindowFunction &window);
+
+
+    /**
+     * Constructor
+     *
+     * @param window    window coefficients, for example the ones of WindowTable
+     *                  (window_tables.h). On the board they are used in place, without any
+     *                  copy, so they must live as long as the front end.
+     * @param size      number of coefficients
+     */
+    FrontEnd(const float *window, size_t size);
+
+
+    /**
+     * Destructor.
+     * Frees the window coefficients, if they have been copied.
+     */
+    ~FrontEnd();
+
+
+    /**
+     * Process a frame.
+     *
+     * @param pcm       PCM samples
+     * @param n         number of samples (if less than the window size, the output is
+     *                  padded with zeros)
+     * @param output    destination, of the same size of the window
+     */
+    void process(const short *pcm, size_t n, float *output);
+
+
+    /**
+     * Get the window size.
+     *
+     * @return number of samples of each frame
+     */
+    size_t getSize();
+
+
+private:
+    size_t size;
+    const float *coefficients;  // Window coefficients, including the normalization on the host
+    float *allocated;           // Coefficients owned by the front end (null if external)
+};
+
+#endif /* FRONT_END_H */
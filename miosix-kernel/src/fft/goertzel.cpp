@@ -0,0 +1,167 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "goertzel.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+
+GoertzelBank::GoertzelBank(const float *frequencies, size_t count, float sampleRate, unsigned int blockSize)
+        : count(count), blockSize(blockSize), threshold(0), hold(0) {
+
+    if (count == 0 || blockSize == 0) {
+        throw invalid_argument("Invalid Goertzel bank parameters");
+    }
+
+    coefficients = (float*) malloc(4 * count * sizeof(float));
+
+    if (!coefficients) {
+        throw runtime_error("Goertzel bank allocation failed");
+    }
+
+    state1 = coefficients + count;
+    state2 = state1 + count;
+    powers = state2 + count;
+
+    for (size_t i = 0; i < count; i++) {
+        if (frequencies[i] <= 0 || frequencies[i] >= sampleRate / 2) {
+            free(coefficients);
+            throw invalid_argument("Invalid Goertzel frequency");
+        }
+
+        coefficients[i] = 2 * cosf(2 * (float) M_PI * frequencies[i] / sampleRate);
+    }
+
+    // A full scale sine gives |X| = 32768 * blockSize / 2
+    scale = 1.0f / (32768.0f * 32768.0f * blockSize * blockSize / 4);
+
+    reset();
+}
+
+
+GoertzelBank::~GoertzelBank() {
+    free(coefficients);
+}
+
+
+void GoertzelBank::process(const short *pcm, unsigned int n) {
+    while (n > 0) {
+        unsigned int length = blockSize - position < n ? blockSize - position : n;
+
+        // Each filter runs on the whole chunk, keeping its state in registers
+        for (size_t i = 0; i < count; i++) {
+            const float coefficient = coefficients[i];
+            float s1 = state1[i];
+            float s2 = state2[i];
+
+            for (unsigned int j = 0; j < length; j++) {
+                float s0 = pcm[j] + coefficient * s1 - s2;
+                s2 = s1;
+                s1 = s0;
+            }
+
+            state1[i] = s1;
+            state2[i] = s2;
+        }
+
+        pcm += length;
+        n -= length;
+        position += length;
+
+        if (position == blockSize)
+            finishBlock();
+    }
+}
+
+
+bool GoertzelBank::addSample(short value) {
+    for (size_t i = 0; i < count; i++) {
+        float s0 = value + coefficients[i] * state1[i] - state2[i];
+        state2[i] = state1[i];
+        state1[i] = s0;
+    }
+
+    if (++position < blockSize)
+        return false;
+
+    finishBlock();
+    return true;
+}
+
+
+void GoertzelBank::finishBlock() {
+    bool above = false;
+
+    for (size_t i = 0; i < count; i++) {
+        float s1 = state1[i];
+        float s2 = state2[i];
+        powers[i] = (s1 * s1 + s2 * s2 - coefficients[i] * s1 * s2) * scale;
+        above |= powers[i] > threshold;
+
+        state1[i] = 0;
+        state2[i] = 0;
+    }
+
+    if (above) {
+        holdLeft = hold + 1;
+    } else if (holdLeft > 0) {
+        holdLeft--;
+    }
+
+    open = holdLeft > 0;
+    position = 0;
+    blocks = blocks + 1;
+}
+
+
+void GoertzelBank::reset() {
+    memset(state1, 0, 3 * count * sizeof(float));
+    position = 0;
+    holdLeft = 0;
+    open = false;
+    blocks = 0;
+}
+
+
+void GoertzelBank::setGate(float threshold, unsigned int hold) {
+    this->threshold = powf(10, threshold / 10);
+    this->hold = hold;
+}
+
+
+bool GoertzelBank::isOpen() {
+    return open;
+}
+
+
+const float* GoertzelBank::getPowers() {
+    return powers;
+}
+
+
+size_t GoertzelBank::getCount() {
+    return count;
+}
+
+
+unsigned int GoertzelBank::getBlocks() {
+    return blocks;
+}
@@ -0,0 +1,144 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef GOERTZEL_H
+#define GOERTZEL_H
+
+#include <cstddef>
+
+/**
+ * Goertzel filters computing the energy of a few frequencies over consecutive blocks of
+ * PCM samples, much cheaper than a whole FFT when only some bands matter.
+ *
+ * The bank can be attached to an audio source as a monitor (see AudioSource::setMonitor), so
+ * that it runs while the samples are produced, and used as a gate: it is open while the
+ * energy of any frequency exceeds a threshold, and for some blocks after that.
+ */
+class GoertzelBank {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param frequencies   frequencies to be analyzed, in Hz
+     * @param count         number of frequencies
+     * @param sampleRate    sample rate, in Hz
+     * @param blockSize     number of samples of each block. The filters have a bandwidth of
+     *                      sampleRate / blockSize.
+     */
+    GoertzelBank(const float *frequencies, size_t count, float sampleRate, unsigned int blockSize);
+
+
+    /**
+     * Destructor.
+     * Frees the filter states.
+     */
+    ~GoertzelBank();
+
+
+    /**
+     * Process a block of samples, of any length.
+     *
+     * @param pcm       samples
+     * @param n         number of samples
+     */
+    void process(const short *pcm, unsigned int n);
+
+
+    /**
+     * Process a single sample.
+     *
+     * @param value     sample
+     * @return true if a block has been completed and the powers have been updated
+     */
+    bool addSample(short value);
+
+
+    /**
+     * Clear the filters and close the gate, to start a new stream.
+     */
+    void reset();
+
+
+    /**
+     * Set the gate parameters.
+     *
+     * @param threshold     minimum power, in dB relative to a full scale sine, of any
+     *                      frequency to open the gate
+     * @param hold          number of blocks the gate stays open after the last one above the
+     *                      threshold
+     */
+    void setGate(float threshold, unsigned int hold);
+
+
+    /**
+     * Check whether the gate is open.
+     *
+     * @return true if the power of a frequency exceeded the threshold in the last hold blocks
+     */
+    bool isOpen();
+
+
+    /**
+     * Get the powers of the last completed block.
+     * A full scale sine at one of the frequencies gives a power of 1.
+     *
+     * @return one power for each frequency
+     */
+    const float* getPowers();
+
+
+    /**
+     * Get the number of frequencies.
+     *
+     * @return number of frequencies
+     */
+    size_t getCount();
+
+
+    /**
+     * Get the number of completed blocks since the last reset.
+     *
+     * @return number of blocks
+     */
+    unsigned int getBlocks();
+
+
+private:
+
+    /**
+     * Compute the powers at the end of a block and update the gate
+     */
+    void finishBlock();
+
+    size_t count;
+    unsigned int blockSize;
+    unsigned int position;      // Samples of the current block already processed
+    float scale;                // Normalization of the powers
+    float *coefficients;        // 2 * cos(2 * pi * f / sampleRate) for each frequency
+    float *state1;              // Last output of each filter
+    float *state2;              // Second to last output of each filter
+    float *powers;              // Powers of the last completed block
+
+    float threshold;            // Linear gate threshold
+    unsigned int hold;
+    unsigned int holdLeft;      // Blocks the gate will still stay open
+    volatile bool open;
+    volatile unsigned int blocks;
+};
+
+#endif /* GOERTZEL_H */
@@ -0,0 +1,191 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "mel_filterbank.h"
+#include "fast_log.h"
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std;
+
+
+static float toMel(float frequency) {
+    return 2595.0f * log10f(1.0f + frequency / 700.0f);
+}
+
+
+static float toFrequency(float mel) {
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+
+MelFilterbank::MelFilterbank(uint16_t fftSize, float sampleRate, uint16_t bands, uint16_t coefficients,
+                             float minFrequency, float maxFrequency)
+        : bands(bands), coefficients(coefficients), weights(nullptr), energies(nullptr), dct(nullptr) {
+
+    const uint16_t bins = fftSize / 2;
+
+    if (maxFrequency == 0) {
+        maxFrequency = sampleRate / 2;
+    }
+
+    if (bins == 0 || bands == 0 || coefficients > bands || minFrequency < 0 ||
+        minFrequency >= maxFrequency || maxFrequency > sampleRate / 2) {
+        throw invalid_argument("Invalid mel filterbank parameters");
+    }
+
+    firstBin = (uint16_t*) malloc(bands * sizeof(uint16_t));
+    binCount = (uint16_t*) malloc(bands * sizeof(uint16_t));
+
+    if (!firstBin || !binCount) {
+        free(firstBin);
+        free(binCount);
+        throw runtime_error("Mel filterbank allocation failed");
+    }
+
+    // Each band goes from the center of the previous one to the center of the next one
+    const float minMel = toMel(minFrequency);
+    const float melStep = (toMel(maxFrequency) - minMel) / (bands + 1);
+    const float binWidth = sampleRate / fftSize;
+    size_t total = 0;
+
+    for (uint16_t b = 0; b < bands; b++) {
+        float lower = toFrequency(minMel + b * melStep) / binWidth;
+        float upper = toFrequency(minMel + (b + 2) * melStep) / binWidth;
+
+        int first = (int) floorf(lower) + 1;
+        int last = (int) ceilf(upper) - 1;
+
+        if (last >= bins) {
+            last = bins - 1;
+        }
+
+        if (last < first) {
+            // Band narrower than the bin spacing: the nearest bin is taken
+            first = last = (int) lroundf(toFrequency(minMel + (b + 1) * melStep) / binWidth);
+
+            if (first >= bins) {
+                first = last = bins - 1;
+            }
+        }
+
+        firstBin[b] = first;
+        binCount[b] = last - first + 1;
+        total += binCount[b];
+    }
+
+    weights = (float*) malloc(total * sizeof(float));
+
+    if (coefficients > 0) {
+        energies = (float*) malloc(bands * sizeof(float));
+        dct = (float*) malloc(coefficients * bands * sizeof(float));
+    }
+
+    if (!weights || (coefficients > 0 && (!energies || !dct))) {
+        free(firstBin);
+        free(binCount);
+        free(weights);
+        free(energies);
+        free(dct);
+        throw runtime_error("Mel filterbank allocation failed");
+    }
+
+    // Triangular weights, with peak 1 at the center of the band
+    float* weight = weights;
+
+    for (uint16_t b = 0; b < bands; b++) {
+        float lower = toFrequency(minMel + b * melStep) / binWidth;
+        float center = toFrequency(minMel + (b + 1) * melStep) / binWidth;
+        float upper = toFrequency(minMel + (b + 2) * melStep) / binWidth;
+
+        for (uint16_t i = 0; i < binCount[b]; i++) {
+            float bin = firstBin[b] + i;
+
+            if (binCount[b] == 1) {
+                *weight = 1;
+            } else if (bin <= center) {
+                *weight = (bin - lower) / (center - lower);
+            } else {
+                *weight = (upper - bin) / (upper - center);
+            }
+
+            weight++;
+        }
+    }
+
+    // Orthonormal DCT-II
+    for (uint16_t k = 0; k < coefficients; k++) {
+        float scale = sqrtf((k == 0 ? 1.0f : 2.0f) / bands);
+
+        for (uint16_t b = 0; b < bands; b++) {
+            dct[k * bands + b] = scale * cosf((float) M_PI * k * (b + 0.5f) / bands);
+        }
+    }
+}
+
+
+MelFilterbank::~MelFilterbank() {
+    free(firstBin);
+    free(binCount);
+    free(weights);
+    free(energies);
+    free(dct);
+}
+
+
+void MelFilterbank::process(const float* power, float* output) {
+    float* destination = coefficients > 0 ? energies : output;
+    const float* weight = weights;
+
+    for (uint16_t b = 0; b < bands; b++) {
+        const float* bin = power + firstBin[b];
+        float sum = 0;
+
+        for (uint16_t i = 0; i < binCount[b]; i++) {
+            sum += bin[i] * weight[i];
+        }
+
+        destination[b] = sum;
+        weight += binCount[b];
+    }
+
+    powerToDb(destination, destination, bands);
+
+    if (coefficients > 0) {
+        for (uint16_t k = 0; k < coefficients; k++) {
+            const float* row = dct + k * bands;
+            float sum = 0;
+
+            for (uint16_t b = 0; b < bands; b++) {
+                sum += row[b] * energies[b];
+            }
+
+            output[k] = sum;
+        }
+    }
+}
+
+
+uint16_t MelFilterbank::getSize() {
+    return coefficients > 0 ? coefficients : bands;
+}
+
+
+uint16_t MelFilterbank::getBands() {
+    return bands;
+}
@@ -0,0 +1,93 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef MEL_FILTERBANK_H
+#define MEL_FILTERBANK_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Feature stage reducing the FFT power spectrum to the energies of triangular bands equally
+ * spaced on the mel scale, in dB, and optionally to the first coefficients of their DCT
+ * (the mel frequency cepstral coefficients).
+ *
+ * The filters are computed once in the constructor and only their nonzero weights are stored,
+ * so each spectrum bin is used at most twice. The code doesn't depend on the board, so the
+ * host tools can compute the same features for the training.
+ */
+class MelFilterbank {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param fftSize           size of the FFT. The spectrum given to process has fftSize / 2 bins.
+     * @param sampleRate        sample rate of the input of the FFT, in Hz
+     * @param bands             number of mel bands
+     * @param coefficients      number of cepstral coefficients to be kept, or 0 to give the
+     *                          band energies without the DCT
+     * @param minFrequency      lower edge of the first band, in Hz
+     * @param maxFrequency      upper edge of the last band, in Hz (0 for half the sample rate)
+     */
+    MelFilterbank(uint16_t fftSize, float sampleRate, uint16_t bands, uint16_t coefficients = 0,
+                  float minFrequency = 0, float maxFrequency = 0);
+
+
+    /**
+     * Destructor.
+     * Frees the filters and the DCT table.
+     */
+    ~MelFilterbank();
+
+
+    /**
+     * Compute the features of a spectrum.
+     *
+     * @param power     power of the fftSize / 2 bins (see FFT_POWER)
+     * @param output    destination of getSize() values
+     */
+    void process(const float* power, float* output);
+
+
+    /**
+     * Get the number of features given by process.
+     *
+     * @return number of coefficients, or number of bands if the DCT is disabled
+     */
+    uint16_t getSize();
+
+
+    /**
+     * Get the number of mel bands.
+     *
+     * @return number of bands
+     */
+    uint16_t getBands();
+
+
+private:
+    uint16_t bands;
+    uint16_t coefficients;
+    uint16_t* firstBin;     // Index of the first bin of each band
+    uint16_t* binCount;     // Number of bins of each band
+    float* weights;         // Nonzero weights of all the bands, one after the other
+    float* energies;        // Band energies, when the DCT is enabled
+    float* dct;             // DCT-II matrix, of coefficients x bands values
+};
+
+#endif /* MEL_FILTERBANK_H */
@@ -0,0 +1,116 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "multi_resolution.h"
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+
+MultiResolutionFFT::MultiResolutionFFT(WindowFunction &longWindow, WindowFunction &shortWindow,
+                                       unsigned int shortFrames, unsigned int shortHop, FftOutput outputType)
+        : longFFT(longWindow.getSize(), FFT_REAL, outputType), shortFFT(shortWindow.getSize(), FFT_REAL, outputType),
+          longWindow(longWindow), shortWindow(shortWindow), shortFrames(shortFrames), shortHop(shortHop) {
+
+    size_t longSize = longFFT.getSize();
+    size_t shortSize = shortFFT.getSize();
+
+    if (shortSize >= longSize || shortFrames == 0 || shortHop == 0 ||
+        shortSize + (shortFrames - 1) * shortHop > longSize) {
+        throw invalid_argument("The short frames don't fit in the long one");
+    }
+
+    samples = (float32_t*) malloc(longSize * sizeof(float32_t));
+
+    if (!samples) {
+        throw runtime_error("Samples buffer allocation failed");
+    }
+
+    features = (float32_t*) malloc(getFeatureCount() * sizeof(float32_t));
+
+    if (!features) {
+        free(samples);
+        throw runtime_error("Features buffer allocation failed");
+    }
+}
+
+
+MultiResolutionFFT::~MultiResolutionFFT() {
+    free(samples);
+    free(features);
+}
+
+
+void MultiResolutionFFT::process(const short *pcm, size_t n) {
+    size_t longSize = longFFT.getSize();
+    size_t shortSize = shortFFT.getSize();
+
+    if (n > longSize)
+        n = longSize;
+
+    // Convert the samples once, for both the resolutions
+    #ifdef _MIOSIX
+        arm_q15_to_float(const_cast<q15_t*>(pcm), samples, n);
+    #else
+        for (size_t i = 0; i < n; i++) {
+            samples[i] = pcm[i] / 32768.0f;
+        }
+    #endif
+
+    if (n < longSize) {
+        memset(samples + n, 0, (longSize - n) * sizeof(float32_t));
+    }
+
+    longWindow.apply(samples, longFFT.getInput(), longSize);
+    longFFT.process();
+    memcpy(features, longFFT.getBins(), longSize / 2 * sizeof(float32_t));
+
+    // Short frames ending at the last sample with data, if possible
+    size_t end = n > shortSize + (shortFrames - 1) * shortHop ? n : shortSize + (shortFrames - 1) * shortHop;
+    float32_t *destination = features + longSize / 2;
+
+    for (unsigned int i = 0; i < shortFrames; i++) {
+        size_t start = end - shortSize - (shortFrames - 1 - i) * shortHop;
+
+        shortWindow.apply(samples + start, shortFFT.getInput(), shortSize);
+        shortFFT.process();
+        memcpy(destination, shortFFT.getBins(), shortSize / 2 * sizeof(float32_t));
+        destination += shortSize / 2;
+    }
+}
+
+
+const float32_t* MultiResolutionFFT::getFeatures() {
+    return features;
+}
+
+
+size_t MultiResolutionFFT::getFeatureCount() {
+    return longFFT.getSize() / 2 + shortFrames * (shortFFT.getSize() / 2);
+}
+
+
+FFT& MultiResolutionFFT::getLongFFT() {
+    return longFFT;
+}
+
+
+FFT& MultiResolutionFFT::getShortFFT() {
+    return shortFFT;
+}
@@ -0,0 +1,115 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef MULTI_RESOLUTION_H
+#define MULTI_RESOLUTION_H
+
+#include "fft.h"
+#include "window.h"
+
+/**
+ * Spectral analysis of the same frame at two resolutions: a long FFT, for the frequency
+ * resolution needed by the tones, and some short FFTs on the end of the frame, for the time
+ * resolution needed by the transients.
+ *
+ * The PCM samples are converted to float once per frame, and both the FFTs are computed from
+ * the converted samples: the short frames are the last ones of the long frame, shortHop samples
+ * apart. If the long frames are taken every shortFrames * shortHop samples, the short frames
+ * follow each other with no gaps and no repetitions, so each one is computed only once.
+ *
+ * Both the FFTs use the real mode, with the CMSIS tables of their sizes.
+ */
+class MultiResolutionFFT {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param longWindow    window of the long frame, whose size is the long FFT size
+     * @param shortWindow   window of the short frames, whose size is the short FFT size
+     * @param shortFrames   number of short frames at the end of each long frame
+     * @param shortHop      distance between two short frames, in samples
+     * @param outputType    values of the bins
+     *
+     * The windows are not copied, so they must live as long as the analysis.
+     */
+    MultiResolutionFFT(WindowFunction &longWindow, WindowFunction &shortWindow, unsigned int shortFrames,
+                       unsigned int shortHop, FftOutput outputType = FFT_MAGNITUDE);
+
+
+    /**
+     * Destructor.
+     * Frees the buffers.
+     */
+    ~MultiResolutionFFT();
+
+
+    /**
+     * Analyze a frame.
+     *
+     * @param pcm   PCM samples
+     * @param n     number of samples (if less than the long FFT size, the frame is padded with
+     *              zeros and the short frames are the last ones with data)
+     */
+    void process(const short *pcm, size_t n);
+
+
+    /**
+     * Get the result of the last analysis: the bins of the long FFT, followed by the ones of
+     * each short frame, from the oldest
+     *
+     * @return pointer to getFeatureCount() values
+     */
+    const float32_t* getFeatures();
+
+
+    /**
+     * Get the number of values of the result
+     *
+     * @return long FFT size / 2 + short frames * short FFT size / 2
+     */
+    size_t getFeatureCount();
+
+
+    /**
+     * Get the long FFT
+     *
+     * @return FFT of the whole frame
+     */
+    FFT& getLongFFT();
+
+
+    /**
+     * Get the short FFT. Its bins are the ones of the newest short frame.
+     *
+     * @return FFT of the short frames
+     */
+    FFT& getShortFFT();
+
+
+private:
+    FFT longFFT;
+    FFT shortFFT;
+    WindowFunction &longWindow;
+    WindowFunction &shortWindow;
+    unsigned int shortFrames;
+    unsigned int shortHop;
+    float32_t *samples;         // Normalized samples of the frame, not windowed
+    float32_t *features;        // Bins of the long FFT and of the short ones
+};
+
+#endif /* MULTI_RESOLUTION_H */
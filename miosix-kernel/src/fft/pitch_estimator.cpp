@@ -0,0 +1,102 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "pitch_estimator.h"
+#include "fast_log.h"
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+
+PitchEstimator::PitchEstimator(uint16_t fftSize, float sampleRate, float minFrequency, float maxFrequency,
+                               FftOutput outputType, float minProminence)
+        : fftSize(fftSize), sampleRate(sampleRate), outputType(outputType), minProminence(minProminence),
+          frequency(0), prominence(0) {
+
+    if (fftSize < 8 || sampleRate <= 0 || minFrequency < 0 || maxFrequency <= minFrequency) {
+        throw invalid_argument("Invalid pitch range");
+    }
+
+    // The interpolation needs a neighbour on each side of the peak
+    float lowest = ceilf(minFrequency * fftSize / sampleRate);
+    float highest = floorf(maxFrequency * fftSize / sampleRate);
+    minBin = lowest > 1 ? (uint16_t) lowest : 1;
+    maxBin = highest < fftSize / 2 - 2 ? (uint16_t) highest : fftSize / 2 - 2;
+
+    if (minBin >= maxBin) {
+        throw invalid_argument("Invalid pitch range");
+    }
+}
+
+
+float PitchEstimator::process(const float *bins) {
+    // All the types of bins grow with the magnitude, so the peak is found without converting them
+    uint16_t peak = minBin;
+
+    for (uint16_t i = minBin + 1; i <= maxBin; i++) {
+        if (bins[i] > bins[peak])
+            peak = i;
+    }
+
+    float mean = 0;
+
+    for (uint16_t i = minBin; i <= maxBin; i++) {
+        mean += getLevel(bins[i]);
+    }
+
+    mean /= maxBin - minBin + 1;
+
+    float previous = getLevel(bins[peak - 1]);
+    float current = getLevel(bins[peak]);
+    float next = getLevel(bins[peak + 1]);
+    prominence = current - mean;
+
+    if (prominence < minProminence) {
+        frequency = 0;
+        return frequency;
+    }
+
+    // Vertex of the parabola through the three levels
+    float curvature = previous - 2 * current + next;
+    float offset = curvature < 0 ? 0.5f * (previous - next) / curvature : 0;
+
+    frequency = (peak + offset) * sampleRate / fftSize;
+    return frequency;
+}
+
+
+float PitchEstimator::getLevel(float value) {
+    // 10 * log10(2) and 20 * log10(2)
+    if (outputType == FFT_MAGNITUDE) {
+        return value > 1e-6f ? 6.0206000f * fastLog2(value) : -120;
+    } else if (outputType == FFT_POWER) {
+        return value > POWER_FLOOR ? 3.0103000f * fastLog2(value) : -120;
+    } else {
+        return value;
+    }
+}
+
+
+float PitchEstimator::getFrequency() {
+    return frequency;
+}
+
+
+float PitchEstimator::getProminence() {
+    return prominence;
+}
@@ -0,0 +1,96 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef PITCH_ESTIMATOR_H
+#define PITCH_ESTIMATOR_H
+
+#include <cstdint>
+#include "fft_output.h"
+
+/**
+ * Estimator of the frequency of a tonal sound, as a whistle, from the bins already computed by
+ * the FFT.
+ *
+ * The pitch is the strongest peak between the minimum and the maximum frequency. Its position
+ * is refined by fitting a parabola to the levels, in dB, of the peak bin and of its neighbours:
+ * with the Hann window the error is below 2% of a bin. A frame is considered tonal if its peak
+ * is higher than the mean level of the range by a minimum prominence, otherwise no pitch is
+ * given.
+ *
+ * Harmonics stronger than the fundamental are not recognized, which is not the case of the
+ * whistles.
+ */
+class PitchEstimator {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param fftSize           size of the FFT giving the bins
+     * @param sampleRate        sample rate of the FFT input, in Hz
+     * @param minFrequency      lowest pitch, in Hz
+     * @param maxFrequency      highest pitch, in Hz
+     * @param outputType        type of the bins
+     * @param minProminence     minimum level of the peak above the mean level of the range, in dB
+     */
+    PitchEstimator(uint16_t fftSize, float sampleRate, float minFrequency = 400, float maxFrequency = 4000,
+                   FftOutput outputType = FFT_MAGNITUDE, float minProminence = 20);
+
+
+    /**
+     * Estimate the pitch of a frame.
+     *
+     * @param bins      first fftSize / 2 bins of the spectrum
+     * @return pitch in Hz, or 0 if the frame is not tonal
+     */
+    float process(const float *bins);
+
+
+    /**
+     * Get the pitch of the last frame.
+     *
+     * @return pitch in Hz, or 0 if the frame is not tonal
+     */
+    float getFrequency();
+
+
+    /**
+     * Get the prominence of the peak of the last frame, even if not tonal.
+     *
+     * @return level of the peak above the mean level of the range, in dB
+     */
+    float getProminence();
+
+
+private:
+    /**
+     * Convert a bin to dB
+     */
+    float getLevel(float value);
+
+    uint16_t fftSize;
+    float sampleRate;
+    uint16_t minBin;
+    uint16_t maxBin;
+    FftOutput outputType;
+    float minProminence;
+
+    float frequency;
+    float prominence;
+};
+
+#endif /* PITCH_ESTIMATOR_H */
@@ -0,0 +1,262 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "sliding_dft.h"
+#include "fast_log.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+
+/**
+ * Find the position of a bin in the sorted list of the tracked ones
+ */
+static uint16_t findBin(const uint16_t *bins, unsigned int count, uint16_t bin) {
+    unsigned int low = 0, high = count - 1;
+
+    while (low < high) {
+        unsigned int middle = (low + high) / 2;
+
+        if (bins[middle] < bin) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return (uint16_t) low;
+}
+
+
+SlidingDFT::SlidingDFT(uint16_t size, const uint16_t *bins, unsigned int count, bool hann, FftOutput outputType)
+        : size(size), count(count), hann(hann), outputType(outputType), resyncFFT(nullptr), resyncPeriod(0) {
+
+    if (size < 4 || count == 0) {
+        throw invalid_argument("Invalid sliding DFT size");
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        if (bins[i] >= size / 2) {
+            throw invalid_argument("Invalid sliding DFT bin");
+        }
+    }
+
+    // Indexes: the tracked bins, followed by the neighbours of each output bin
+    unsigned int maxTracked = hann ? 3 * count : count;
+    trackedBins = (uint16_t*) malloc((maxTracked + 3 * count) * sizeof(uint16_t));
+
+    if (!trackedBins) {
+        throw runtime_error("Sliding DFT bins allocation failed");
+    }
+
+    neighbours = trackedBins + maxTracked;
+
+    // Collect the tracked bins. X(-1) is the conjugate of X(1), as the samples are real.
+    tracked = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+        trackedBins[tracked++] = bins[i];
+
+        if (hann) {
+            trackedBins[tracked++] = bins[i] == 0 ? 1 : bins[i] - 1;
+            trackedBins[tracked++] = bins[i] + 1;
+        }
+    }
+
+    // Sort them and remove the duplicates
+    for (unsigned int i = 1; i < tracked; i++) {
+        uint16_t bin = trackedBins[i];
+        unsigned int j = i;
+
+        for (; j > 0 && trackedBins[j - 1] > bin; j--) {
+            trackedBins[j] = trackedBins[j - 1];
+        }
+
+        trackedBins[j] = bin;
+    }
+
+    unsigned int unique = 1;
+
+    for (unsigned int i = 1; i < tracked; i++) {
+        if (trackedBins[i] != trackedBins[unique - 1]) {
+            trackedBins[unique++] = trackedBins[i];
+        }
+    }
+
+    tracked = unique;
+
+    for (unsigned int i = 0; i < count; i++) {
+        uint16_t bin = bins[i];
+        neighbours[3 * i + 1] = findBin(trackedBins, tracked, bin);
+
+        if (hann) {
+            neighbours[3 * i] = findBin(trackedBins, tracked, bin == 0 ? 1 : bin - 1);
+            neighbours[3 * i + 2] = findBin(trackedBins, tracked, bin + 1);
+        }
+    }
+
+    // State, twiddle factors and output
+    real = (float32_t*) malloc((4 * tracked + count) * sizeof(float32_t));
+
+    if (!real) {
+        free(trackedBins);
+        throw runtime_error("Sliding DFT state allocation failed");
+    }
+
+    imaginary = real + tracked;
+    twiddleReal = imaginary + tracked;
+    twiddleImaginary = twiddleReal + tracked;
+    output = twiddleImaginary + tracked;
+
+    for (unsigned int i = 0; i < tracked; i++) {
+        double phase = 2 * M_PI * trackedBins[i] / size;
+        twiddleReal[i] = (float32_t) cos(phase);
+        twiddleImaginary[i] = (float32_t) sin(phase);
+    }
+
+    history = (short*) malloc(size * sizeof(short));
+
+    if (!history) {
+        free(trackedBins);
+        free(real);
+        throw runtime_error("Sliding DFT history allocation failed");
+    }
+
+    reset();
+}
+
+
+SlidingDFT::~SlidingDFT() {
+    free(trackedBins);
+    free(real);
+    free(history);
+}
+
+
+void SlidingDFT::setResync(FFT *fft, unsigned int period) {
+    if (fft && (fft->getSize() != size || period == 0)) {
+        throw invalid_argument("Invalid sliding DFT resync");
+    }
+
+    resyncFFT = fft;
+    resyncPeriod = period;
+    sinceResync = 0;
+}
+
+
+void SlidingDFT::process(const short *pcm, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        // The oldest sample leaves the window and the new one enters it
+        float32_t delta = (float32_t) (pcm[i] - history[position]) * (1.0f / 32768);
+        history[position] = pcm[i];
+        position = position + 1 < size ? position + 1 : 0;
+
+        for (unsigned int j = 0; j < tracked; j++) {
+            float32_t a = real[j] + delta;
+            float32_t b = imaginary[j];
+            real[j] = a * twiddleReal[j] - b * twiddleImaginary[j];
+            imaginary[j] = a * twiddleImaginary[j] + b * twiddleReal[j];
+        }
+
+        if (resyncFFT && ++sinceResync >= resyncPeriod) {
+            resync();
+        }
+    }
+
+    updateOutput();
+}
+
+
+void SlidingDFT::resync() {
+    if (!resyncFFT)
+        return;
+
+    // The oldest sample is the first one of the FFT frame, as in the sliding DFT
+    float32_t *input = resyncFFT->getInput();
+
+    for (uint16_t i = 0, j = position; i < size; i++) {
+        input[i] = history[j] * (1.0f / 32768);
+        j = j + 1 < size ? j + 1 : 0;
+    }
+
+    resyncFFT->process();
+
+    for (unsigned int i = 0; i < tracked; i++) {
+        resyncFFT->getComplexBin(trackedBins[i], real[i], imaginary[i]);
+    }
+
+    sinceResync = 0;
+    updateOutput();
+}
+
+
+void SlidingDFT::reset() {
+    memset(real, 0, 2 * tracked * sizeof(float32_t));
+    memset(output, 0, count * sizeof(float32_t));
+    memset(history, 0, size * sizeof(short));
+    position = 0;
+    sinceResync = 0;
+
+    if (outputType == FFT_LOG_POWER) {
+        powerToDb(output, output, count);
+    }
+}
+
+
+void SlidingDFT::updateOutput() {
+    for (unsigned int i = 0; i < count; i++) {
+        uint16_t center = neighbours[3 * i + 1];
+        float32_t re = real[center];
+        float32_t im = imaginary[center];
+
+        if (hann) {
+            uint16_t lower = neighbours[3 * i];
+            uint16_t upper = neighbours[3 * i + 2];
+
+            // The lower neighbour of the DC bin is the conjugate of bin 1
+            float32_t lowerImaginary = trackedBins[center] == 0 ? -imaginary[lower] : imaginary[lower];
+
+            re = 0.5f * re - 0.25f * (real[lower] + real[upper]);
+            im = 0.5f * im - 0.25f * (lowerImaginary + imaginary[upper]);
+        }
+
+        float32_t power = re * re + im * im;
+        output[i] = outputType == FFT_MAGNITUDE ? sqrtf(power) : power;
+    }
+
+    if (outputType == FFT_LOG_POWER) {
+        powerToDb(output, output, count);
+    }
+}
+
+
+const float32_t* SlidingDFT::getBins() {
+    return output;
+}
+
+
+unsigned int SlidingDFT::getCount() {
+    return count;
+}
+
+
+uint16_t SlidingDFT::getSize() {
+    return size;
+}
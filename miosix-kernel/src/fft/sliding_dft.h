@@ -0,0 +1,145 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef SLIDING_DFT_H
+#define SLIDING_DFT_H
+
+#include "fft.h"
+
+/**
+ * Sliding DFT of some bins of the last size samples, updated at each new sample with a cost
+ * independent of the size. It gives the same bins of an FFT of the last frame, but at any time,
+ * so that a model on a few bins can run at a higher rate than the FFT.
+ *
+ * Each bin is updated as X(n) = e^(j 2 pi k / N) * (X(n - 1) + x(n) - x(n - N)). The rounding
+ * errors accumulate over time, so the bins are periodically recomputed from the last samples
+ * with an FFT (resync).
+ *
+ * The Hann window is applied in the frequency domain, combining each bin with its neighbours:
+ * Y(k) = X(k) / 2 - (X(k - 1) + X(k + 1)) / 4. It is the periodic Hann window, which differs
+ * from the symmetric one of window.h by less than 1 / size.
+ */
+class SlidingDFT {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param size          number of samples of the transform
+     * @param bins          indexes of the bins to be computed (less than size / 2)
+     * @param count         number of bins
+     * @param hann          whether to apply the Hann window (otherwise the rectangular one)
+     * @param outputType    values to be computed for each bin
+     */
+    SlidingDFT(uint16_t size, const uint16_t *bins, unsigned int count, bool hann = true,
+               FftOutput outputType = FFT_MAGNITUDE);
+
+
+    /**
+     * Destructor.
+     * Frees the buffers.
+     */
+    ~SlidingDFT();
+
+
+    /**
+     * Recompute the bins with an FFT every given number of samples.
+     * The FFT input is overwritten, so the FFT must not be used elsewhere at the same time.
+     *
+     * @param fft       FFT of the same size, or nullptr to disable the resync
+     * @param period    number of samples between two resyncs
+     */
+    void setResync(FFT *fft, unsigned int period);
+
+
+    /**
+     * Add new samples and update the output bins
+     *
+     * @param pcm   PCM samples
+     * @param n     number of samples
+     */
+    void process(const short *pcm, size_t n);
+
+
+    /**
+     * Recompute the bins from the last samples, with the FFT given to setResync
+     */
+    void resync();
+
+
+    /**
+     * Discard all the samples
+     */
+    void reset();
+
+
+    /**
+     * Get the output bins, in the order of the constructor.
+     *
+     * @return count values, of the type chosen in the constructor
+     */
+    const float32_t* getBins();
+
+
+    /**
+     * Get the number of output bins
+     *
+     * @return number of bins
+     */
+    unsigned int getCount();
+
+
+    /**
+     * Get the transform size
+     *
+     * @return number of samples
+     */
+    uint16_t getSize();
+
+
+private:
+    /**
+     * Compute the output bins from the tracked ones
+     */
+    void updateOutput();
+
+    uint16_t size;
+    unsigned int count;
+    bool hann;
+    FftOutput outputType;
+
+    // Bins updated at each sample: the output ones and, with the Hann window, their neighbours
+    unsigned int tracked;
+    uint16_t *trackedBins;
+    float32_t *real;
+    float32_t *imaginary;
+    float32_t *twiddleReal;     // e^(j 2 pi k / N)
+    float32_t *twiddleImaginary;
+
+    // Positions of X(k - 1), X(k), X(k + 1) of each output bin among the tracked ones
+    uint16_t *neighbours;
+
+    float32_t *output;
+    short *history;             // Last size samples, as a ring
+    uint16_t position;          // Position of the oldest sample of the history
+
+    FFT *resyncFFT;
+    unsigned int resyncPeriod;
+    unsigned int sinceResync;   // Samples processed since the last resync
+};
+
+#endif /* SLIDING_DFT_H */
@@ -0,0 +1,222 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "spectrogram.h"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+
+Half SpectrogramTraits<Half>::encode(float value) {
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+
+    uint32_t sign = (x >> 16) & 0x8000u;
+    int exponent = (int) ((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = x & 0x7fffffu;
+    Half result;
+
+    if (exponent == 128 + 15) {
+        // Infinite or NaN
+        result.bits = (uint16_t) (sign | 0x7c00u | (mantissa ? 0x200u : 0));
+
+    } else if (exponent >= 31) {
+        // Too large: infinite
+        result.bits = (uint16_t) (sign | 0x7c00u);
+
+    } else if (exponent <= 0) {
+        // Denormal or zero, rounded to the nearest even
+        if (exponent < -10) {
+            result.bits = (uint16_t) sign;
+        } else {
+            mantissa |= 0x800000u;
+            unsigned int shift = 14 - exponent;
+            uint32_t value = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t half = 1u << (shift - 1);
+
+            if (remainder > half || (remainder == half && (value & 1)))
+                value++;
+
+            result.bits = (uint16_t) (sign | value);
+        }
+
+    } else {
+        // Normal, rounded to the nearest even. A carry can reach the exponent, correctly.
+        uint32_t value = ((uint32_t) exponent << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1fffu;
+
+        if (remainder > 0x1000u || (remainder == 0x1000u && (value & 1)))
+            value++;
+
+        result.bits = (uint16_t) (sign | value);
+    }
+
+    return result;
+}
+
+
+float SpectrogramTraits<Half>::decode(Half value) {
+    uint32_t sign = (uint32_t) (value.bits & 0x8000u) << 16;
+    uint32_t exponent = (value.bits >> 10) & 0x1f;
+    uint32_t mantissa = value.bits & 0x3ffu;
+    uint32_t x;
+
+    if (exponent == 0) {
+        // Denormal or zero: mantissa * 2^-24
+        float result = mantissa * 5.9604645e-8f;
+        return sign ? -result : result;
+
+    } else if (exponent == 31) {
+        x = sign | 0x7f800000u | (mantissa << 13);
+
+    } else {
+        x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &x, sizeof(result));
+    return result;
+}
+
+
+template<typename T>
+Spectrogram<T>::Spectrogram(size_t bins, size_t frames, SpectrogramLayout layout, size_t slack)
+        : bins(bins), frames(frames), layout(layout) {
+
+    if (bins == 0 || frames == 0) {
+        throw invalid_argument("Invalid spectrogram size");
+    }
+
+    columns = frames + (slack > 0 ? slack : frames);
+    ring = (T*) malloc(bins * columns * sizeof(T));
+
+    if (!ring) {
+        throw runtime_error("Spectrogram allocation failed");
+    }
+
+    reset();
+}
+
+
+template<typename T>
+Spectrogram<T>::~Spectrogram() {
+    free(ring);
+}
+
+
+template<typename T>
+void Spectrogram<T>::push(const float *values) {
+    if (end == columns)
+        compact();
+
+    if (layout == SPECTROGRAM_TIME_MAJOR) {
+        T *column = ring + end * bins;
+
+        for (size_t i = 0; i < bins; i++) {
+            column[i] = SpectrogramTraits<T>::encode(values[i]);
+        }
+
+    } else {
+        T *column = ring + end;
+
+        for (size_t i = 0; i < bins; i++) {
+            column[i * columns] = SpectrogramTraits<T>::encode(values[i]);
+        }
+    }
+
+    end++;
+    count++;
+}
+
+
+template<typename T>
+void Spectrogram<T>::compact() {
+    // The oldest frame of the history is going to be discarded
+    size_t kept = frames - 1;
+    size_t first = end - kept;
+
+    if (layout == SPECTROGRAM_TIME_MAJOR) {
+        memmove(ring, ring + first * bins, kept * bins * sizeof(T));
+    } else {
+        for (size_t i = 0; i < bins; i++) {
+            memmove(ring + i * columns, ring + i * columns + first, kept * sizeof(T));
+        }
+    }
+
+    end = kept;
+}
+
+
+template<typename T>
+void Spectrogram<T>::reset() {
+    // All the bits to zero are 0 for both float and Half
+    memset(ring, 0, bins * columns * sizeof(T));
+    end = frames;
+    count = 0;
+}
+
+
+template<typename T>
+const T* Spectrogram<T>::getView() {
+    size_t first = end - frames;
+    return layout == SPECTROGRAM_TIME_MAJOR ? ring + first * bins : ring + first;
+}
+
+
+template<typename T>
+size_t Spectrogram<T>::getStride() {
+    return layout == SPECTROGRAM_TIME_MAJOR ? bins : columns;
+}
+
+
+template<typename T>
+float Spectrogram<T>::getValue(size_t frame, size_t bin) {
+    const T *view = getView();
+    size_t index = layout == SPECTROGRAM_TIME_MAJOR ? frame * bins + bin : bin * columns + frame;
+    return SpectrogramTraits<T>::decode(view[index]);
+}
+
+
+template<typename T>
+size_t Spectrogram<T>::getBins() {
+    return bins;
+}
+
+
+template<typename T>
+size_t Spectrogram<T>::getFrames() {
+    return frames;
+}
+
+
+template<typename T>
+unsigned int Spectrogram<T>::getCount() {
+    return count;
+}
+
+
+template<typename T>
+SpectrogramLayout Spectrogram<T>::getLayout() {
+    return layout;
+}
+
+
+template class Spectrogram<float>;
+template class Spectrogram<Half>;
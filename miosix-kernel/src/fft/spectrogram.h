@@ -0,0 +1,193 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef SPECTROGRAM_H
+#define SPECTROGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Half precision (IEEE 754 binary16) value, stored as its bits.
+ * It has 11 significant bits and a range from 6e-5 (6e-8 with the denormals) to 65504, so it
+ * is well suited to the log-power spectrum, while small magnitudes lose precision.
+ */
+struct Half {
+    uint16_t bits;
+};
+
+
+/**
+ * Conversion between the values of the spectrum and the storage type
+ */
+template<typename T>
+struct SpectrogramTraits;
+
+template<>
+struct SpectrogramTraits<float> {
+    static float encode(float value) {
+        return value;
+    }
+
+    static float decode(float value) {
+        return value;
+    }
+};
+
+template<>
+struct SpectrogramTraits<Half> {
+    static Half encode(float value);
+    static float decode(Half value);
+};
+
+
+typedef enum {
+    SPECTROGRAM_TIME_MAJOR,         // Frames one after the other, from the oldest
+    SPECTROGRAM_FREQUENCY_MAJOR     // History of each bin, from the oldest frame
+} SpectrogramLayout;
+
+
+/**
+ * History of the last frames of a spectrum, as a matrix to be given to a model.
+ *
+ * The frames are kept in a ring preallocated at construction. The ring is longer than the
+ * history by some slack columns: the frames are appended after the last one, so the history is
+ * always contiguous and can be read in place, and only when the end of the buffer is reached
+ * the history is moved back to its beginning. A larger slack makes the moves rarer: their
+ * cost per frame is (frames - 1) / slack copies of a frame.
+ *
+ * With the time-major layout the whole history is a single contiguous block of
+ * frames x bins values. With the frequency-major layout the history of each bin is contiguous,
+ * and the rows of the bins are getStride() values apart.
+ *
+ * Until the history is full, the missing oldest frames are zeros.
+ *
+ * Instantiated for float and Half values.
+ */
+template<typename T>
+class Spectrogram {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param bins      values of each frame
+     * @param frames    number of frames of the history
+     * @param layout    order of the values in memory
+     * @param slack     additional frames of the ring (0 for the same number of the history)
+     */
+    Spectrogram(size_t bins, size_t frames, SpectrogramLayout layout = SPECTROGRAM_TIME_MAJOR, size_t slack = 0);
+
+
+    /**
+     * Destructor.
+     * Frees the ring.
+     */
+    ~Spectrogram();
+
+
+    /**
+     * Append a frame, discarding the oldest one
+     *
+     * @param values    bins of the new frame
+     */
+    void push(const float *values);
+
+
+    /**
+     * Discard the history, replacing it with zeros
+     */
+    void reset();
+
+
+    /**
+     * Get the history, without copying it. The pointer is valid until the next push.
+     *
+     * With the time-major layout, bin b of frame t (0 is the oldest one) is at
+     * [t * getStride() + b], otherwise at [b * getStride() + t].
+     *
+     * @return first value of the oldest frame
+     */
+    const T* getView();
+
+
+    /**
+     * Get the distance between the rows of the view
+     *
+     * @return number of bins with the time-major layout, otherwise the length of the ring
+     */
+    size_t getStride();
+
+
+    /**
+     * Get a value of the history, converted to float
+     *
+     * @param frame     frame index, 0 is the oldest one
+     * @param bin       bin index
+     * @return value
+     */
+    float getValue(size_t frame, size_t bin);
+
+
+    /**
+     * Get the number of values of each frame
+     *
+     * @return number of bins
+     */
+    size_t getBins();
+
+
+    /**
+     * Get the length of the history
+     *
+     * @return number of frames
+     */
+    size_t getFrames();
+
+
+    /**
+     * Get the number of frames pushed since the construction or the last reset
+     *
+     * @return number of frames
+     */
+    unsigned int getCount();
+
+
+    /**
+     * Get the layout of the values
+     *
+     * @return layout
+     */
+    SpectrogramLayout getLayout();
+
+
+private:
+    /**
+     * Move the history, except its oldest frame, to the beginning of the ring
+     */
+    void compact();
+
+    size_t bins;
+    size_t frames;
+    size_t columns;                 // Frames in the ring, history and slack
+    SpectrogramLayout layout;
+    T *ring;
+    size_t end;                     // Column after the newest frame
+    unsigned int count;
+};
+
+#endif /* SPECTROGRAM_H */
@@ -18,23 +18,61 @@
 #include "window.h"
 #include <cstdlib>
 #include <math.h>
+#include <stdexcept>
+
+#ifdef _MIOSIX
+#include "fft.h"
+#endif
+
+using namespace std;
 
 size_t WindowFunction::getSize() {
     return size;
 }
 
-HannWindow::HannWindow(int size) : WindowFunction(size) {
-    multipliers = (double*) malloc(size * sizeof(double));
+const float* WindowFunction::getCoefficients() {
+    return coefficients;
+}
+
+void WindowFunction::apply(const float *in, float *out, size_t n) {
+    if (n > size)
+        n = size;
+
+    #ifdef _MIOSIX
+        arm_mult_f32(const_cast<float*>(in), const_cast<float*>(coefficients), out, n);
+    #else
+        for (size_t i = 0; i < n; i++) {
+            out[i] = in[i] * coefficients[i];
+        }
+    #endif
+}
+
+CosineWindow::CosineWindow(WindowType type, size_t size) : WindowFunction(size) {
+    values = (float*) malloc(size * sizeof(float));
 
-    for (int i = 0; i < size; i++) {
-        multipliers[i] = 0.5 * (1 - cos(2 * M_PI * i / (size - 1)));
+    if (!values) {
+        throw runtime_error("Window coefficients allocation failed");
     }
+
+    for (size_t i = 0; i < size; i++) {
+        double phase = 2 * M_PI * i / (size - 1);
+        double value = 0;
+
+        // Same terms of the compile time tables
+        for (unsigned int k = 0; k < WINDOW_TERMS; k++) {
+            value += windowTerm(type, k) * cos(k * phase);
+        }
+
+        values[i] = (float) value;
+    }
+
+    coefficients = values;
 }
 
-HannWindow::~HannWindow() {
-    free(multipliers);
+CosineWindow::~CosineWindow() {
+    free(values);
 }
 
-float HannWindow::apply(float value, int index) {
-    return value * multipliers[index];
-}
\ No newline at end of file
+TableWindow::TableWindow(const float *coefficients, size_t size) : WindowFunction(size) {
+    this->coefficients = coefficients;
+}
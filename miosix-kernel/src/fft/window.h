@@ -19,10 +19,15 @@
 #define WINDOW_H
 
 #include <cstdio>
+#include "window_tables.h"
 
+/**
+ * Window function, stored as a table of coefficients and applied to whole blocks of samples
+ */
 class WindowFunction {
 public:
-    explicit WindowFunction(size_t size) : size(size) {};
+    explicit WindowFunction(size_t size) : size(size), coefficients(nullptr) {};
+    virtual ~WindowFunction() {};
 
     /**
      * Get the window size
@@ -30,23 +35,70 @@ public:
     size_t getSize();
 
     /**
-     * Apply the window function to a value given its index
+     * Get the window coefficients
      */
-    virtual float apply(float value, int index) = 0;
+    const float* getCoefficients();
+
+    /**
+     * Apply the window function to a block of samples.
+     * Input and output can be the same buffer.
+     *
+     * @param in    input samples, starting from the beginning of the window
+     * @param out   destination of the windowed samples
+     * @param n     number of samples (at most the window size)
+     */
+    void apply(const float *in, float *out, size_t n);
 
 protected:
     size_t size;
+    const float *coefficients;
 };
 
 
-class HannWindow : public WindowFunction {
+/**
+ * Window given by a sum of cosines, computed at runtime for any size
+ */
+class CosineWindow : public WindowFunction {
 public:
-    explicit HannWindow(int size);
-    ~HannWindow();
-    float apply(float value, int index) override;
+    CosineWindow(WindowType type, size_t size);
+    ~CosineWindow();
 
 private:
-    double* multipliers;
+    float *values;
+};
+
+
+class HannWindow : public CosineWindow {
+public:
+    explicit HannWindow(size_t size) : CosineWindow(WINDOW_HANN, size) {};
+};
+
+
+class HammingWindow : public CosineWindow {
+public:
+    explicit HammingWindow(size_t size) : CosineWindow(WINDOW_HAMMING, size) {};
+};
+
+
+class BlackmanHarrisWindow : public CosineWindow {
+public:
+    explicit BlackmanHarrisWindow(size_t size) : CosineWindow(WINDOW_BLACKMAN_HARRIS, size) {};
+};
+
+
+class FlatTopWindow : public CosineWindow {
+public:
+    explicit FlatTopWindow(size_t size) : CosineWindow(WINDOW_FLAT_TOP, size) {};
+};
+
+
+/**
+ * Window whose coefficients are already computed, for example by WindowTable (window_tables.h).
+ * The coefficients are not copied, so they must live as long as the window.
+ */
+class TableWindow : public WindowFunction {
+public:
+    TableWindow(const float *coefficients, size_t size);
 };
 
 #endif /* WINDOW_H */
@@ -0,0 +1,150 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef WINDOW_TABLES_H
+#define WINDOW_TABLES_H
+
+/**
+ * Window coefficients computed by the compiler and stored in flash.
+ *
+ * WindowTable<type, size>::values is a constant array of floats, so it takes no RAM and no
+ * time at startup. Being a template, only the tables actually used are linked.
+ *
+ * All the windows are sums of cosines, w(i) = sum of a(k) cos(k x) with x = 2 pi i / (size - 1),
+ * so they are symmetric: w(i) = w(size - 1 - i). The same terms are used by the runtime windows
+ * of window.h.
+ */
+
+typedef enum {
+    WINDOW_HANN,                // 0.5 - 0.5 cos(x)
+    WINDOW_HAMMING,             // 0.54 - 0.46 cos(x)
+    WINDOW_BLACKMAN,            // 0.42 - 0.5 cos(x) + 0.08 cos(2x)
+    WINDOW_BLACKMAN_HARRIS,     // 4 terms, -92 dB side lobes
+    WINDOW_FLAT_TOP             // 5 terms, amplitude error below 0.01 dB
+} WindowType;
+
+
+// Helpers of the compile time computation
+
+constexpr double windowPi = 3.14159265358979323846;
+
+/**
+ * Taylor series of the cosine, accurate to the double precision for |x| <= pi
+ */
+constexpr double windowCosSeries(double x2, double term, unsigned int n) {
+    return n > 24 ? term : term + windowCosSeries(x2, -term * x2 / ((2.0 * n - 1) * (2.0 * n)), n + 1);
+}
+
+/**
+ * Cosine of x + pi, for |x| <= pi
+ */
+constexpr double windowCosShifted(double x) {
+    return -windowCosSeries(x * x, 1.0, 1);
+}
+
+/**
+ * Cosine of a non negative angle, reduced to [-pi, pi] around pi
+ */
+constexpr double windowCosine(double x) {
+    return windowCosShifted(x - 2 * windowPi * (long long) (x / (2 * windowPi)) - windowPi);
+}
+
+constexpr double windowPhase(unsigned int index, unsigned int size) {
+    return 2 * windowPi * index / (size - 1);
+}
+
+// Maximum number of terms of the windows
+#define WINDOW_TERMS 5
+
+/**
+ * Coefficient a(k) of the cosine k x, with its sign
+ */
+constexpr double windowTerm(WindowType type, unsigned int k) {
+    return type == WINDOW_HANN ? (k == 0 ? 0.5 : k == 1 ? -0.5 : 0) :
+           type == WINDOW_HAMMING ? (k == 0 ? 0.54 : k == 1 ? -0.46 : 0) :
+           type == WINDOW_BLACKMAN ? (k == 0 ? 0.42 : k == 1 ? -0.5 : k == 2 ? 0.08 : 0) :
+           type == WINDOW_BLACKMAN_HARRIS ?
+               (k == 0 ? 0.35875 : k == 1 ? -0.48829 : k == 2 ? 0.14128 : k == 3 ? -0.01168 : 0) :
+           (k == 0 ? 0.21557895 : k == 1 ? -0.41663158 : k == 2 ? 0.277263158 :
+            k == 3 ? -0.083578947 : k == 4 ? 0.006947368 : 0);
+}
+
+/**
+ * Sum of the terms from k on. The missing ones are skipped, without computing their cosine.
+ */
+constexpr double windowSum(WindowType type, double phase, unsigned int k) {
+    return k >= WINDOW_TERMS ? 0 :
+           (windowTerm(type, k) == 0 ? 0 : windowTerm(type, k) * (k == 0 ? 1 : windowCosine(k * phase))) +
+           windowSum(type, phase, k + 1);
+}
+
+constexpr float windowValue(WindowType type, unsigned int index, unsigned int size) {
+    return (float) windowSum(type, windowPhase(index, size), 0);
+}
+
+
+/**
+ * Compile time list of indexes, built with a logarithmic template depth
+ */
+template<unsigned int... I>
+struct IndexList {};
+
+template<typename A, typename B>
+struct ConcatIndexLists;
+
+template<unsigned int... A, unsigned int... B>
+struct ConcatIndexLists<IndexList<A...>, IndexList<B...>> {
+    typedef IndexList<A..., (sizeof...(A) + B)...> type;
+};
+
+template<unsigned int N>
+struct MakeIndexList {
+    typedef typename ConcatIndexLists<typename MakeIndexList<N / 2>::type, typename MakeIndexList<N - N / 2>::type>::type type;
+};
+
+template<>
+struct MakeIndexList<0> {
+    typedef IndexList<> type;
+};
+
+template<>
+struct MakeIndexList<1> {
+    typedef IndexList<0> type;
+};
+
+
+template<WindowType Type, unsigned int Size, typename Indexes>
+struct WindowTableData;
+
+template<WindowType Type, unsigned int Size, unsigned int... I>
+struct WindowTableData<Type, Size, IndexList<I...>> {
+    static constexpr float values[Size] = { windowValue(Type, I, Size)... };
+};
+
+template<WindowType Type, unsigned int Size, unsigned int... I>
+constexpr float WindowTableData<Type, Size, IndexList<I...>>::values[Size];
+
+
+/**
+ * Coefficients of a window, for the sizes supported by the FFT (powers of 2 from 16 to 4096)
+ */
+template<WindowType Type, unsigned int Size>
+struct WindowTable : WindowTableData<Type, Size, typename MakeIndexList<Size>::type> {
+    static_assert(Size >= 16 && Size <= 4096 && (Size & (Size - 1)) == 0, "Invalid window size");
+};
+
+#endif /* WINDOW_TABLES_H */
@@ -16,15 +16,31 @@
  **************************************************************************/
 
 #include <cstdio>
+#include <cstring>
 #include <miosix.h>
-#include <functional>
 #include <termios.h>
+#include <fcntl.h>
+#include "audio/activity_detector.h"
+#include "audio/file_source.h"
+#include "audio/onset_detector.h"
+#include "fft/feature_normalizer.h"
 #include "fft/fft.h"
+#include "fft/fixed_fft.h"
+#include "fft/front_end.h"
+#include "fft/goertzel.h"
+#include "fft/mel_filterbank.h"
+#include "fft/multi_resolution.h"
+#include "fft/pitch_estimator.h"
+#include "fft/spectrogram.h"
 #include "fft/window.h"
+#include "fft/window_tables.h"
+#include "benchmark/benchmark.h"
+#include "benchmark/cycles.h"
 #include "neural-network/network.h"
 #include "neural-network/network_data.h"
 #include "peripheral/button.h"
 #include "peripheral/microphone.h"
+#include "peripheral/i2s_clock.h"
 #include "peripheral/crc.h"
 
 
@@ -32,6 +48,23 @@
 // To be used to get the data to train the neural network.
 //#define TRAINING
 
+// Uncomment to run the signal processing benchmarks instead of the classifier.
+// The results are printed on the serial port.
+//#define BENCHMARK
+
+// Uncomment to classify a WAV recording stored in the SD card instead of the microphone audio.
+// The recording is streamed in real time, with the same sample rate of the microphone.
+//#define AUDIO_FILE "/sd/recording.wav"
+
+// Uncomment to compute the spectrum in Q15 fixed point. The saving is small: the Q15 FFT keeps
+// a complex in place buffer (4 bytes per sample), its output (1), a RAM copy of the window (2)
+// and the float spectrum given to the features (2), that is 9 bytes per sample against the 10
+// of the float FFT in real mode, which reads the window from flash: about 1 KiB with 1024
+// samples. The features and the neural network are still in floating point, and the firmware
+// is linked with the hard float libraries of the Cortex-M4, so a floating point unit is needed
+// anyway.
+//#define FIXED_POINT
+
 
 using namespace std;
 using namespace miosix;
@@ -55,31 +88,296 @@ void sendStartSignal();
 void sendStopSignal();
 
 
+/**
+ * Write the capture statistics to the serial port
+ */
+void sendStats();
+
+
+/**
+ * Freeze the audio retained before an event and hand it to the pre-roll writer thread.
+ * Does nothing if the previous pre-roll is still being saved.
+ *
+ * @param event     event name
+ */
+void savePreRoll(const char *event);
+
+
+/**
+ * Wait for the pre-roll writer thread to save the last frozen pre-roll
+ */
+void waitPreRoll();
+
+
+/**
+ * Save the frozen pre-rolls, either to the serial port or to the SD card, releasing the
+ * samples as they are written
+ */
+void* preRollWriter(void* arg);
+
+
+/**
+ * Write the header of a 16 bit mono WAV file
+ *
+ * @param fd        file descriptor
+ * @param rate      sample rate
+ * @param samples   number of samples that will follow the header
+ */
+void writeWavHeader(int fd, unsigned int rate, unsigned int samples);
+
+
+/**
+ * Periodically write the capture statistics while recording
+ */
+void* statsReporter(void* arg);
+
+
 /**
  * Elaborate the recorded audio
  *
- * @param data  data chunk
- * @param n     samples amount
+ * @param data          data chunk
+ * @param n             samples amount
+ * @param firstSample   index of the first sample since the start of the recording
+ */
+void scanAudio(const short* data, unsigned int n, unsigned long long firstSample);
+
+
+/**
+ * Compute the spectrum of a frame and, with MEL_BANDS, its mel features
+ *
+ * @param data          data chunk
+ * @param n             samples amount
  */
-void scanAudio(short* data, unsigned int n);
+void computeSpectrum(const short* data, unsigned int n);
 
 
 /**
- * Normalize a value according to its type
+ * Run the FFT and the neural network on a skipped frame, discarding the results, to measure
+ * the load without the frame skipping
  *
- * @tparam T        data type
- * @param value     value to be normalized
- * @param sign      true if the data type is signed; false otherwise
- * @return normalized value
+ * @param data          data chunk
+ * @param n             samples amount
  */
-template<typename T>
-float normalize(T value, bool sign);
+void measureFullFrame(const short* data, unsigned int n);
+
+
+
+// Audio
+// The neural network has been trained on 32 kHz audio. Other rates (see the clock
+// configurations in peripheral/i2s_clock.h) need a new training.
+#define SAMPLE_RATE PCM_32KHZ
+static AudioSource* source;
 
+// Actual rate of the samples, used to convert the bins and the sample indexes to frequencies
+// and times. The microphone one differs slightly from the nominal rate because of the I2S clock
+// dividers, while a recording is streamed at its nominal rate.
+#ifdef AUDIO_FILE
+#define EXACT_SAMPLE_RATE ((float) SAMPLE_RATE)
+#else
+#define EXACT_SAMPLE_RATE ((float) getI2sClockConfig(SAMPLE_RATE).getExactRate())
+#endif
 
 
 // FFT
 #define FFT_SIZE 1024
+
+// Window applied to each frame: WINDOW_HANN, WINDOW_HAMMING, WINDOW_BLACKMAN,
+// WINDOW_BLACKMAN_HARRIS (lower leakage, for tones near loud noise) or WINDOW_FLAT_TOP
+// (accurate amplitudes, for level measurements). The network must be trained again after
+// changing it.
+#define WINDOW_TYPE WINDOW_HANN
+
+// Values of the spectrum given to the neural network and sent in training mode:
+// FFT_MAGNITUDE, FFT_POWER or FFT_LOG_POWER (in dB). The network must be trained again
+// after changing it.
+#define FFT_OUTPUT FFT_MAGNITUDE
+
+// Uncomment to give the neural network the energies of MEL_BANDS mel bands, in dB, instead of
+// the FFT bins. If MFCC_COEFFICIENTS is greater than 0, the energies are replaced by the first
+// coefficients of their DCT. The filterbank needs FFT_OUTPUT set to FFT_POWER, and the network
+// must be trained on the same features (see MEL_extract.cpp).
+//#define MEL_BANDS 40
+#define MFCC_COEFFICIENTS 0
+
+// Uncomment to add to the FFT bins the spectra of the last SHORT_FFT_FRAMES frames of
+// SHORT_FFT_SIZE samples, SHORT_FFT_HOP samples apart, which resolve the claps better in time.
+// The short frames are taken from the same samples of the long one; with SHORT_FFT_FRAMES *
+// SHORT_FFT_HOP equal to HOP_SIZE they cover the whole stream. The network must be trained
+// again. Not available with MEL_BANDS and FIXED_POINT.
+//#define SHORT_FFT_SIZE 256
+#define SHORT_FFT_FRAMES 2
+#define SHORT_FFT_HOP 128
+
+#if defined(SHORT_FFT_SIZE) && (defined(MEL_BANDS) || defined(FIXED_POINT))
+#error "The multi-resolution analysis needs the float FFT bins"
+#endif
+
+#ifdef MEL_BANDS
+#define FEATURE_COUNT (MFCC_COEFFICIENTS > 0 ? MFCC_COEFFICIENTS : MEL_BANDS)
+#elif defined(SHORT_FFT_SIZE)
+#define FEATURE_COUNT (FFT_SIZE / 2 + SHORT_FFT_FRAMES * (SHORT_FFT_SIZE / 2))
+#else
+#define FEATURE_COUNT (FFT_SIZE / 2)
+#endif
+
+// Distance, in samples, between the beginning of two consecutive frames.
+// A hop smaller than the FFT size gives overlapping frames and a finer time resolution,
+// at the cost of more FFTs and inferences per second. The training data is sent without
+// overlap, as the serial port is not fast enough.
+#ifdef TRAINING
+#define HOP_SIZE FFT_SIZE
+#else
+#define HOP_SIZE (FFT_SIZE / 4)
+#endif
+#ifdef FIXED_POINT
+static FixedFFT<q15_t>* fft;
+static float32_t fixedSpectrum[FFT_SIZE / 2];
+#else
 static FFT* fft;
+#ifdef SHORT_FFT_SIZE
+static MultiResolutionFFT* multiResolution;
+#else
+static FrontEnd* frontEnd;
+#endif
+#endif
+static const float32_t* spectrum;
+
+#ifdef MEL_BANDS
+static MelFilterbank* mel;
+static float32_t melFeatures[FEATURE_COUNT];
+#endif
+
+// Features of the frame, also sent in training mode
+static const float32_t* features;
+
+// Uncomment to normalize each feature to zero mean and unit variance, with running statistics
+// over about NORMALIZATION_TIME seconds, so that the network input doesn't depend on the gain
+// and the distance of the microphone. If NORMALIZATION_WARMUP is greater than 0, the statistics
+// are frozen after that number of seconds of sound. Applied in training mode too: the network
+// must be trained again after changing it. The statistics only include the frames that are
+// classified, also in training mode, where the ones skipped by the activity detection or the
+// Goertzel gate are still sent.
+//#define FEATURE_NORMALIZATION
+#define NORMALIZATION_TIME 4
+#define NORMALIZATION_WARMUP 0
+
+#ifdef FEATURE_NORMALIZATION
+static FeatureNormalizer* normalizer;
+static const float32_t* rawFeatures;
+static float32_t normalizedFeatures[FEATURE_COUNT];
+#endif
+
+// The detectors of the frames to skip also run in training mode when the features are
+// normalized, to leave the same frames out of the statistics
+#if !defined(TRAINING) || defined(FEATURE_NORMALIZATION)
+#define FRAME_SKIPPING
+#endif
+
+// Uncomment to give the neural network the features of the last CONTEXT_FRAMES classified
+// frames, the oldest first, instead of the current frame only, so that it can tell a short
+// transient from a sustained sound. The frames skipped by the activity detection or the
+// Goertzel gate are not part of the context. Training mode still sends one frame at a time,
+// and the context must be built in the same way on the host.
+//#define CONTEXT_FRAMES 8
+
+#ifdef CONTEXT_FRAMES
+#define NETWORK_INPUT_SIZE (FEATURE_COUNT * CONTEXT_FRAMES)
+#else
+#define NETWORK_INPUT_SIZE FEATURE_COUNT
+#endif
+
+#if defined(CONTEXT_FRAMES) && !defined(TRAINING)
+static Spectrogram<float>* context;
+#endif
+
+
+// Quiet frames are classified as silence without computing their spectrum and running the
+// neural network. A frame is quiet unless its energy exceeds the adaptive noise floor by
+// ACTIVITY_THRESHOLD dB, with a zero crossing rate of at least ACTIVITY_MIN_ZCR, or one of the
+// previous ACTIVITY_HOLD frames was not quiet. The noise floor rises by at most ACTIVITY_RISE
+// dB per second during the quiet frames, and ACTIVITY_ACTIVE_RISE during the other ones, so
+// that a stationary noise louder than the previous background is absorbed after a while.
+// Comment out ACTIVITY_DETECTION to classify all the frames. Ignored in training mode.
+#define ACTIVITY_DETECTION
+#define ACTIVITY_THRESHOLD 9
+#define ACTIVITY_MIN_ZCR 0.01f
+#define ACTIVITY_HOLD 4
+#define ACTIVITY_RISE 5
+#define ACTIVITY_ACTIVE_RISE 0.5f
+
+#if defined(ACTIVITY_DETECTION) && defined(FRAME_SKIPPING)
+static ActivityDetector* activity;
+#endif
+
+// Uncomment to run the FFT and the neural network only when one of the GATE_FREQUENCIES has a
+// power above GATE_THRESHOLD (in dB relative to a full scale sine). The powers are computed by
+// Goertzel filters on blocks of GATE_BLOCK samples, while the audio is recorded. The gate stays
+// open for GATE_HOLD blocks after the last one above the threshold, so that the frames with
+// the end of a sound are classified too. Ignored in training mode.
+//#define GOERTZEL_GATE
+#define GATE_THRESHOLD -60
+#define GATE_BLOCK 256
+#define GATE_HOLD 16
+static const float gateFrequencies[] = {800, 1200, 1600, 2000, 2500, 3000};
+
+#if defined(GOERTZEL_GATE) && defined(FRAME_SKIPPING)
+static GoertzelBank* gate;
+#endif
+
+// Onsets (sounds starting abruptly, as the claps) are found with the spectral flux of the FFT
+// bins and located in the samples. Each one is reported with a "#onset sample=... time=..."
+// line, with its position since the start of the recording, and the claps report the time of
+// the onset found in their frame or in the previous one, if any. A frame is an onset when its
+// flux exceeds its average by ONSET_SENSITIVITY times its mean deviation, and at least
+// ONSET_MIN_FLUX. The following ONSET_REFRACTORY frames are not checked. Needs FFT_OUTPUT set
+// to FFT_MAGNITUDE or FFT_POWER. Ignored in training mode.
+#define ONSET_DETECTION
+#define ONSET_SENSITIVITY 4
+#define ONSET_MIN_FLUX 0.3f
+#define ONSET_REFRACTORY 4
+
+#if defined(ONSET_DETECTION) && !defined(TRAINING)
+static OnsetDetector* onsetDetector;
+#endif
+
+// The whistles are printed with their pitch, estimated from the FFT bins between PITCH_MIN and
+// PITCH_MAX (in Hz). Ignored in training mode.
+#define PITCH_TRACKING
+#define PITCH_MIN 400
+#define PITCH_MAX 4000
+
+#if defined(PITCH_TRACKING) && !defined(TRAINING)
+static PitchEstimator* pitch;
+#endif
+
+// Uncomment to also run the FFT and the neural network on the frames skipped by the activity
+// detection and the Goertzel gate, discarding their results, so that the "#stats" lines report
+// the load the same audio would have without the frame skipping (full_load) next to the actual
+// one. The onset detection, the feature normalization and the context ignore these frames.
+// Ignored in training mode.
+//#define MEASURE_FULL_LOAD
+
+// Frame processing load, measured in the callback and, for the gate, in the thread producing
+// the samples
+static volatile unsigned long long busyCycles;      // Cycles spent on all the frames
+static volatile unsigned long long monitorCycles;   // Cycles spent by the gate on the samples
+static volatile unsigned long long fullCycles;      // Cycles of all the frames without skipping
+static volatile unsigned int classifiedFrames;
+static volatile unsigned int gatedFrames;           // Frames skipped because the gate was closed
+static long long recordingStart;                    // Start of the recording, in ticks
+
+#if defined(GOERTZEL_GATE) && !defined(TRAINING)
+/**
+ * Monitor running the gate on the new samples and adding its time to the load
+ */
+struct TimedGate {
+    void process(const short *pcm, unsigned int n) {
+        unsigned int start = cycleCount();
+        gate->process(pcm, n);
+        monitorCycles = monitorCycles + (cycleCount() - start);
+    }
+};
+#endif
 
 
 // Neural network
@@ -96,12 +394,128 @@ typedef enum {NONE, SILENCE, WHISTLE, CLAP} state_t;
 static state_t state;
 
 
+// Capture statistics report period, in milliseconds
+#define STATS_PERIOD 10000
+static volatile bool recording = false;
+
+
+// Audio retained in memory and saved when a whistle or a clap is detected, in milliseconds
+// (0 to disable). The audio is saved in the SD card, or sent on the serial port after a
+// "#preroll" line if PRE_ROLL_DIR is commented out. The samples are written by a dedicated
+// thread while the classification goes on, but the serial port is much slower than the
+// microphone: during the transfer most of the new samples are dropped, and the messages of
+// the classifier wait for its end.
+#define PRE_ROLL_TIME 500
+#define PRE_ROLL_DIR "/sd"
+
+// Serializes the binary transfers with the messages of the other threads
+static pthread_mutex_t serialMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Pre-roll handed to the writer thread
+static pthread_mutex_t preRollMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t preRollCond = PTHREAD_COND_INITIALIZER;
+static const char *preRollEvent;        // Event of the frozen pre-roll; nullptr if none
+static unsigned int preRollSamples;     // Number of samples frozen
+static bool preRollBusy;                // Whether a pre-roll is waiting or being saved
+
+
 int main() {
     try {
-        // Initialize the FFT structure
-        static FFT mFFT(FFT_SIZE);
+        // Initialize the FFT structure. The window coefficients are computed at compile time.
+        const float *windowCoefficients = WindowTable<WINDOW_TYPE, FFT_SIZE>::values;
+
+        #ifdef FIXED_POINT
+        static TableWindow window(windowCoefficients, FFT_SIZE);
+        static FixedFFT<q15_t> mFFT(FFT_SIZE, &window, FFT_OUTPUT);
+        fft = &mFFT;
+        spectrum = fixedSpectrum;
+        #elif defined(SHORT_FFT_SIZE)
+        static TableWindow longWindow(windowCoefficients, FFT_SIZE);
+        static TableWindow shortWindow(WindowTable<WINDOW_TYPE, SHORT_FFT_SIZE>::values, SHORT_FFT_SIZE);
+        static MultiResolutionFFT mMultiResolution(longWindow, shortWindow, SHORT_FFT_FRAMES, SHORT_FFT_HOP, FFT_OUTPUT);
+        multiResolution = &mMultiResolution;
+        fft = &multiResolution->getLongFFT();
+        spectrum = multiResolution->getFeatures();
+        #else
+        static FFT mFFT(FFT_SIZE, FFT_REAL, FFT_OUTPUT);
         fft = &mFFT;
 
+        // Initialize the conversion of the samples to the FFT input
+        static FrontEnd mFrontEnd(windowCoefficients, FFT_SIZE);
+        frontEnd = &mFrontEnd;
+        spectrum = fft->getBins();
+        #endif
+
+        // The frequencies of the bins, as the ones of all the following stages, are computed
+        // with the actual sample rate
+        fft->setSampleRate(EXACT_SAMPLE_RATE);
+
+        // Initialize the feature extraction
+        #ifdef MEL_BANDS
+        static_assert(FFT_OUTPUT == FFT_POWER, "The mel filterbank needs the power spectrum");
+        static MelFilterbank mMel(FFT_SIZE, EXACT_SAMPLE_RATE, MEL_BANDS, MFCC_COEFFICIENTS);
+        mel = &mMel;
+        features = melFeatures;
+        #else
+        features = spectrum;
+        #endif
+
+        #ifdef FEATURE_NORMALIZATION
+        static FeatureNormalizer mNormalizer(FEATURE_COUNT, (float) HOP_SIZE / (NORMALIZATION_TIME * SAMPLE_RATE));
+        normalizer = &mNormalizer;
+        rawFeatures = features;
+        features = normalizedFeatures;
+        #endif
+
+        #if defined(CONTEXT_FRAMES) && !defined(TRAINING)
+        static Spectrogram<float> mContext(FEATURE_COUNT, CONTEXT_FRAMES);
+        context = &mContext;
+        #endif
+
+        // Initialize the audio source
+        #ifdef AUDIO_FILE
+        static FileAudioSource fileSource(AUDIO_FILE, AUDIO_WAV, true);
+        source = &fileSource;
+        #else
+        static MicrophoneSource microphone;
+        source = &microphone;
+        #endif
+
+        // Initialize the activity detection
+        #if defined(ACTIVITY_DETECTION) && defined(FRAME_SKIPPING)
+        static ActivityDetector mActivity((float) HOP_SIZE / SAMPLE_RATE, ACTIVITY_THRESHOLD,
+                                          ACTIVITY_MIN_ZCR, ACTIVITY_HOLD, ACTIVITY_RISE,
+                                          ACTIVITY_ACTIVE_RISE);
+        activity = &mActivity;
+        #endif
+
+        // Initialize the gate, which runs while the samples are produced
+        #if defined(GOERTZEL_GATE) && defined(FRAME_SKIPPING)
+        static GoertzelBank mGate(gateFrequencies, sizeof(gateFrequencies) / sizeof(gateFrequencies[0]),
+                                  EXACT_SAMPLE_RATE, GATE_BLOCK);
+        mGate.setGate(GATE_THRESHOLD, GATE_HOLD);
+        gate = &mGate;
+
+        #ifdef TRAINING
+        source->setMonitor(gate);
+        #else
+        static TimedGate timedGate;
+        source->setMonitor(&timedGate);
+        #endif
+        #endif
+
+        // Initialize the onset detection
+        #if defined(ONSET_DETECTION) && !defined(TRAINING)
+        static_assert(FFT_OUTPUT != FFT_LOG_POWER, "The onset detection needs the linear spectrum");
+        static OnsetDetector mOnsetDetector(FFT_SIZE / 2, ONSET_SENSITIVITY, ONSET_MIN_FLUX, ONSET_REFRACTORY);
+        onsetDetector = &mOnsetDetector;
+        #endif
+
+        #if defined(PITCH_TRACKING) && !defined(TRAINING)
+        static PitchEstimator mPitch(FFT_SIZE, EXACT_SAMPLE_RATE, PITCH_MIN, PITCH_MAX, FFT_OUTPUT);
+        pitch = &mPitch;
+        #endif
+
     } catch (exception &e) {
         printf("%s\r\n", e.what());
         while (true);
@@ -111,6 +525,11 @@ int main() {
     Crc::init();
     setRawStdout();
 
+    #ifdef BENCHMARK
+    runBenchmarks();
+    while (true);
+    #endif
+
     // Neural network setup
     #ifndef TRAINING
     ai_error aiError = ai_network_create(&network, (ai_buffer*) AI_NETWORK_DATA_CONFIG);
@@ -136,9 +555,20 @@ int main() {
     }
 
     nn_input[0].n_batches = 1;
-    nn_input[0].data = AI_HANDLE_PTR(fft->getBins());
+    static_assert(AI_NETWORK_IN_1_SIZE == NETWORK_INPUT_SIZE, "The neural network has been trained on different features");
+    nn_input[0].data = AI_HANDLE_PTR(features);
     nn_output[0].n_batches = 1;
     nn_output[0].data = AI_HANDLE_PTR(nn_outData);
+
+    pthread_t statsThread;
+    pthread_create(&statsThread, nullptr, statsReporter, nullptr);
+
+    #if PRE_ROLL_TIME > 0 && !defined(AUDIO_FILE)
+    pthread_t preRollThread;
+    pthread_create(&preRollThread, nullptr, preRollWriter, nullptr);
+    #endif
+
+    Microphone::setPreRoll(PRE_ROLL_TIME);
     #endif
 
     // Main loop
@@ -146,13 +576,41 @@ int main() {
         // Start the recording on user button press
         UserButton::wait();
         state = NONE;
+        busyCycles = 0;
+        monitorCycles = 0;
+        fullCycles = 0;
+        classifiedFrames = 0;
+        gatedFrames = 0;
+        recordingStart = getTick();
+
+        #if defined(ACTIVITY_DETECTION) && defined(FRAME_SKIPPING)
+        activity->reset();
+        #endif
+
+        #if defined(GOERTZEL_GATE) && defined(FRAME_SKIPPING)
+        gate->reset();
+        #endif
+
+        #if defined(ONSET_DETECTION) && !defined(TRAINING)
+        onsetDetector->reset();
+        #endif
+
+        #if defined(CONTEXT_FRAMES) && !defined(TRAINING)
+        context->reset();
+        #endif
+
+        // The start clears the ring, so the last pre-roll must have been saved
+        waitPreRoll();
+
         sendStartSignal();
-        function<void (short*, unsigned int)> callback = bind(scanAudio, placeholders::_1, placeholders::_2);
-        Microphone::start(callback, fft->getSize());
+        source->start<scanAudio>(fft->getSize(), HOP_SIZE, SAMPLE_RATE);
+        recording = true;
 
         // Stop on second button press
         UserButton::wait();
-        Microphone::stop();
+        recording = false;
+        source->stop();
+        waitPreRoll();
         sendStopSignal();
     }
 }
@@ -170,7 +628,7 @@ void sendStartSignal() {
     printf("#start\r\n");
 
     #ifdef TRAINING
-        int value = FFT_SIZE / 2 * sizeof(float);
+        int value = FEATURE_COUNT * sizeof(float);
         write(STDOUT_FILENO, &value, sizeof(int));
     #endif
 }
@@ -181,34 +639,287 @@ void sendStopSignal() {
         int value = 0;
         write(STDOUT_FILENO, &value, sizeof(int));
     #else
+        sendStats();
         printf("#stop\r\n");
     #endif
 }
 
 
-void scanAudio(short* data, unsigned int n) {
-    static HannWindow hann(FFT_SIZE);
+void sendStats() {
+    // The capture statistics only concern the microphone: a recording is never dropped
+    #ifndef AUDIO_FILE
+    MicrophoneStats stats = Microphone::getStats();
+    #endif
+
+    pthread_mutex_lock(&serialMutex);
+
+    #ifndef AUDIO_FILE
+    printf("#stats frames=%u overwritten=%u torn=%u dma_starvations=%u pdm_lost=%u max_callback=%uus start_latency=%uus\r\n",
+           stats.framesProduced, stats.framesOverwritten, stats.framesTorn, stats.dmaStarvations,
+           stats.pdmBlocksLost, stats.maxCallbackTime, stats.startLatency);
+
+    if (stats.samplesDropped > 0)
+        printf("#stats preroll_dropped=%u\r\n", stats.samplesDropped);
+    #endif
 
-    for (unsigned int i = 0; i < n; i++) {
-        float value = normalize<short>(data[i], true);
-        value = hann.apply(value, i);
-        fft->addSample(value);;
+    // Share of the time spent on the frames, including the gate running on the samples. With
+    // MEASURE_FULL_LOAD, the load without the frame skipping is measured in the same run.
+    float elapsed = (float) (getTick() - recordingStart) / TICK_FREQ * SystemCoreClock;
+    unsigned int quiet = 0;
+
+    #if defined(ACTIVITY_DETECTION) && !defined(TRAINING)
+    quiet = activity->getSkippedFrames();
+    #endif
+
+    if (elapsed > 0) {
+        float gateLoad = monitorCycles / elapsed * 100;
+        float load = busyCycles / elapsed * 100 + gateLoad;
+
+        printf("#stats load=%.1f%% gate_load=%.1f%% classified_frames=%u quiet_frames=%u gated_frames=%u\r\n",
+               load, gateLoad, (unsigned int) classifiedFrames, quiet, (unsigned int) gatedFrames);
+
+        #if defined(MEASURE_FULL_LOAD) && !defined(TRAINING)
+        printf("#stats full_load=%.1f%%\r\n", fullCycles / elapsed * 100);
+        #endif
+    }
+
+    pthread_mutex_unlock(&serialMutex);
+}
+
+
+void savePreRoll(const char *event) {
+    #if PRE_ROLL_TIME > 0 && !defined(AUDIO_FILE)
+        // The ring is not frozen again until the previous pre-roll has been released
+        unsigned int samples = Microphone::freezePreRoll();
+
+        if (samples == 0)
+            return;
+
+        pthread_mutex_lock(&preRollMutex);
+        preRollEvent = event;
+        preRollSamples = samples;
+        preRollBusy = true;
+        pthread_cond_broadcast(&preRollCond);
+        pthread_mutex_unlock(&preRollMutex);
+    #endif
+}
+
+
+void waitPreRoll() {
+    #if PRE_ROLL_TIME > 0 && !defined(AUDIO_FILE)
+        pthread_mutex_lock(&preRollMutex);
+
+        while (preRollBusy)
+            pthread_cond_wait(&preRollCond, &preRollMutex);
+
+        pthread_mutex_unlock(&preRollMutex);
+    #endif
+}
+
+
+void* preRollWriter(void* arg) {
+    #if PRE_ROLL_TIME > 0 && !defined(AUDIO_FILE)
+    while (true) {
+        pthread_mutex_lock(&preRollMutex);
+
+        while (preRollEvent == nullptr)
+            pthread_cond_wait(&preRollCond, &preRollMutex);
+
+        const char *event = preRollEvent;
+        unsigned int samples = preRollSamples;
+        preRollEvent = nullptr;
+        pthread_mutex_unlock(&preRollMutex);
+
+        unsigned int rate = Microphone::getSampleRate();
+
+        #ifdef PRE_ROLL_DIR
+            static unsigned int eventsCount = 0;
+            char path[64];
+            snprintf(path, sizeof(path), "%s/%s%u.wav", PRE_ROLL_DIR, event, eventsCount++);
+            int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+            if (fd >= 0)
+                writeWavHeader(fd, rate, samples);
+        #else
+            pthread_mutex_lock(&serialMutex);
+            printf("#preroll %s %u %u\r\n", event, rate, samples);
+            fflush(stdout);
+            int fd = STDOUT_FILENO;
+        #endif
+
+        // The samples are written directly from the PCM history, which can't be overwritten
+        // until they are released. Once the last one is released, the ring can be frozen again
+        // for the next event, so exactly the announced samples are read.
+        unsigned int remaining = samples;
+
+        while (remaining > 0) {
+            unsigned int count;
+            const short *data = Microphone::getPreRoll(count);
+
+            if (count == 0)
+                break;
+
+            if (count > remaining)
+                count = remaining;
+
+            if (fd >= 0)
+                write(fd, data, count * sizeof(short));
+
+            Microphone::releasePreRoll(count);
+            remaining -= count;
+        }
+
+        #ifdef PRE_ROLL_DIR
+            if (fd >= 0)
+                close(fd);
+        #else
+            pthread_mutex_unlock(&serialMutex);
+        #endif
+
+        // A new event may have been frozen in the meanwhile
+        pthread_mutex_lock(&preRollMutex);
+
+        if (preRollEvent == nullptr) {
+            preRollBusy = false;
+            pthread_cond_broadcast(&preRollCond);
+        }
+
+        pthread_mutex_unlock(&preRollMutex);
+    }
+    #endif
+
+    return nullptr;
+}
+
+
+void writeWavHeader(int fd, unsigned int rate, unsigned int samples) {
+    unsigned int values[] = { 36 + samples * 2, 16, 1 | (1 << 16), rate, rate * 2, 2 | (16 << 16), samples * 2 };
+    unsigned char header[44];
+
+    memcpy(header, "RIFF", 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    memcpy(header + 36, "data", 4);
+
+    // Little endian fields, as in the memory of the board
+    memcpy(header + 4, &values[0], 4);
+    memcpy(header + 16, &values[1], 20);
+    memcpy(header + 40, &values[6], 4);
+
+    write(fd, header, sizeof(header));
+}
+
+
+void* statsReporter(void* arg) {
+    while (true) {
+        Thread::sleep(STATS_PERIOD);
+
+        if (recording) {
+            sendStats();
+        }
+    }
+
+    return nullptr;
+}
+
+
+void scanAudio(const short* data, unsigned int n, unsigned long long firstSample) {
+    #ifndef TRAINING
+    unsigned int start = cycleCount();
+    #endif
+
+    #if defined(ACTIVITY_DETECTION) && !defined(TRAINING)
+    if (!activity->process(data, n)) {
+        // Nothing but background noise
+        state = SILENCE;
+        busyCycles = busyCycles + (cycleCount() - start);
+
+        #ifdef MEASURE_FULL_LOAD
+        measureFullFrame(data, n);
+        #endif
+        return;
     }
+    #endif
 
-    // If the data is not enough, fill with zeros
-    for (int i = n; i < fft->getSize(); i++) {
-        fft->addSample(0);
+    #if defined(GOERTZEL_GATE) && !defined(TRAINING)
+    if (!gate->isOpen()) {
+        // Nothing in the bands of interest
+        state = SILENCE;
+        gatedFrames = gatedFrames + 1;
+        busyCycles = busyCycles + (cycleCount() - start);
+
+        #ifdef MEASURE_FULL_LOAD
+        measureFullFrame(data, n);
+        #endif
+        return;
     }
+    #endif
+
+    #if defined(FEATURE_NORMALIZATION) && defined(TRAINING)
+    // The frames skipped at inference are sent too, but left out of the statistics
+    bool active = true;
+
+    #ifdef ACTIVITY_DETECTION
+    active = activity->process(data, n);
+    #endif
+
+    #ifdef GOERTZEL_GATE
+    active = active && gate->isOpen();
+    #endif
+    #endif
 
-    fft->process();
+    #ifdef MEASURE_FULL_LOAD
+    // Without the frame skipping, the detectors wouldn't run
+    unsigned int pipelineStart = cycleCount();
+    #endif
+
+    computeSpectrum(data, n);
+
+    #ifdef FEATURE_NORMALIZATION
+        #ifdef TRAINING
+        normalizer->process(rawFeatures, normalizedFeatures, active);
+        #else
+        normalizer->process(rawFeatures, normalizedFeatures);
+        #endif
+
+        #if NORMALIZATION_WARMUP > 0
+        if (normalizer->getFrames() >= NORMALIZATION_WARMUP * SAMPLE_RATE / HOP_SIZE) {
+            normalizer->setFrozen(true);
+        }
+        #endif
+    #endif
+
+    #if defined(ONSET_DETECTION) && !defined(TRAINING)
+        // The first FFT_SIZE / 2 values of the spectrum are the FFT bins in all the modes
+        if (onsetDetector->process(spectrum, data, n, firstSample)) {
+            unsigned long long onset = onsetDetector->getOnset();
+            pthread_mutex_lock(&serialMutex);
+            printf("#onset sample=%llu time=%.4f\r\n", onset, (double) onset / EXACT_SAMPLE_RATE);
+            pthread_mutex_unlock(&serialMutex);
+        }
+    #endif
 
     #ifdef TRAINING
-        int s = FFT_SIZE / 2 * sizeof(float);
+        int s = FEATURE_COUNT * sizeof(float);
         write(STDOUT_FILENO, &s, sizeof(int));
-        write(STDOUT_FILENO, fft->getBins(), s);
+        write(STDOUT_FILENO, features, s);
     #else
+        #ifdef CONTEXT_FRAMES
+        // The history is read in place, and it moves in the ring at each frame
+        context->push(features);
+        nn_input[0].data = AI_HANDLE_PTR(context->getView());
+        #endif
+
         ai_network_run(network, &nn_input[0], &nn_output[0]);
 
+        // The pre-roll transfer is not part of the processing load
+        unsigned int cycles = cycleCount() - start;
+        busyCycles = busyCycles + cycles;
+        classifiedFrames = classifiedFrames + 1;
+
+        #ifdef MEASURE_FULL_LOAD
+        fullCycles = fullCycles + (cycleCount() - pipelineStart);
+        #endif
+
         if (nn_outData[0] > nn_outData[1] && nn_outData[0] > nn_outData[2]) {
             if (state != SILENCE) {
                 state = SILENCE;
@@ -217,41 +928,77 @@ void scanAudio(short* data, unsigned int n) {
         } else if (nn_outData[1] > nn_outData[0] && nn_outData[1] > nn_outData[2]) {
             if (state != WHISTLE) {
                 state = WHISTLE;
+
+                // The first FFT_SIZE / 2 values of the spectrum are the FFT bins in all the modes
+                #if defined(PITCH_TRACKING) && !defined(TRAINING)
+                float frequency = pitch->process(spectrum);
+                pthread_mutex_lock(&serialMutex);
+
+                if (frequency > 0) {
+                    printf("Whistle at %.1f Hz\r\n", frequency);
+                } else {
+                    printf("Whistle\r\n");
+                }
+                #else
+                pthread_mutex_lock(&serialMutex);
                 printf("Whistle\r\n");
+                #endif
+
+                pthread_mutex_unlock(&serialMutex);
+                savePreRoll("whistle");
             }
 
         } else {
             if (state != CLAP) {
                 state = CLAP;
+                pthread_mutex_lock(&serialMutex);
+
+                #if defined(ONSET_DETECTION) && !defined(TRAINING)
+                // Only an onset of this frame or of the previous one belongs to the clap
+                if (onsetDetector->getOnsets() > 0 && onsetDetector->getOnsetFrame() + HOP_SIZE >= firstSample) {
+                    printf("Clap at %.4f s\r\n", (double) onsetDetector->getOnset() / EXACT_SAMPLE_RATE);
+                } else {
+                    printf("Clap\r\n");
+                }
+                #else
                 printf("Clap\r\n");
+                #endif
+
+                pthread_mutex_unlock(&serialMutex);
+                savePreRoll("clap");
             }
         }
     #endif
 }
 
 
-template<typename T>
-float normalize(T value, bool sign) {
-    float result;
+void computeSpectrum(const short* data, unsigned int n) {
+    #ifdef FIXED_POINT
+        // The PCM samples are already in Q15 format
+        memcpy(fft->getInput(), data, n * sizeof(short));
+        fft->process();
+        fft->getFeatures(fixedSpectrum);
+    #elif defined(SHORT_FFT_SIZE)
+        multiResolution->process(data, n);
+    #else
+        frontEnd->process(data, n, fft->getInput());
+        fft->process();
+    #endif
 
-    // Determine the divisor
-    T *normalizationFactor = (T*) malloc(sizeof(T));
+    #ifdef MEL_BANDS
+        mel->process(spectrum, melFeatures);
+    #endif
+}
 
-    // Set all the bits to 1
-    for (unsigned int i = 0; i < sizeof(T); i++) {
-        for (unsigned int j = 0; j < 8; j++) {
-            *((char*) normalizationFactor + i) |= 1u << j;
-        }
-    }
 
-    // Set the first bit to 0 in case of signed type
-    if (sign) {
-        *normalizationFactor &= ~(1ull << (8 * sizeof(T) - 1));
-    }
+#if defined(MEASURE_FULL_LOAD) && !defined(TRAINING)
+void measureFullFrame(const short* data, unsigned int n) {
+    unsigned int start = cycleCount();
 
-    // Normalize
-    result = value / ((float) *normalizationFactor + 1);
+    // The spectrum is stateless, and the state was already set to silence
+    computeSpectrum(data, n);
+    ai_network_run(network, &nn_input[0], &nn_output[0]);
 
-    free(normalizationFactor);
-    return result;
-}
\ No newline at end of file
+    fullCycles = fullCycles + (cycleCount() - start);
+}
+#endif
@@ -0,0 +1,98 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#include "decimator.h"
+#include <algorithm>
+
+using namespace std;
+
+/*
+ * Filter coefficients (Q15), designed with the Kaiser window method.
+ * Frequencies are relative to the input rate of each filter.
+ */
+
+// Half-band, 35 taps: -0.06 dB at 0.2, -43 dB at 0.3, below -75 dB from 0.35
+static const short halfBandCoefficients[] = {
+    10332, -3191, 1638, -919, 509, -263, 120, -44, 9
+};
+
+// Inverse of the CIC droop up to 0.4: the cascade with the CIC is flat within 0.15 dB up to 0.35
+static const int32_t compensationCoefficients[] = {
+    87, -333, 828, -1581, 2447, -2983, 1480, 32994, 1480, -2983, 2447, -1581, 828, -333, 87
+};
+
+// Inverse of the CIC droop up to 0.19, low-pass for the decimation by 2: -26 dB at 0.27,
+// below -64 dB from 0.3
+static const int32_t compensationDecimatorCoefficients[] = {
+    1, 1, 0, 1, -3, -13, 10, 52, -8, -143, -37, 307, 192, -549, -570, 835, 1371, -1086, -3175,
+    1048, 10415, 15484, 10415, 1048, -3175, -1086, 1371, 835, -570, -549, 192, 307, -37, -143,
+    -8, 52, 10, -13, -3, 1, 0, 1, 1
+};
+
+
+DecimationChain::DecimationChain(PcmRate rate) : rate(rate),
+                                                 halfBand(halfBandCoefficients),
+                                                 compensation(compensationCoefficients),
+                                                 compensationDecimator(compensationDecimatorCoefficients) {
+}
+
+
+void DecimationChain::reset() {
+    cic8.reset();
+    cic16.reset();
+    halfBand.reset();
+    compensation.reset();
+    compensationDecimator.reset();
+}
+
+
+unsigned int DecimationChain::getSampleRate() {
+    return rate;
+}
+
+
+unsigned int DecimationChain::process(const unsigned short *pdm, unsigned int words,
+                                      short *pcm, unsigned int maxSamples, unsigned int &produced) {
+    unsigned int consumed = 0;
+    produced = 0;
+
+    while (consumed < words && produced < maxSamples) {
+        // Each PDM word produces at most one output sample, so the output buffer can't overflow
+        unsigned int length = min(min(words - consumed, maxSamples - produced), blockSize);
+        unsigned int samples;
+        short hb, out;
+
+        if (rate == PCM_32KHZ || rate == PCM_48KHZ) {
+            samples = cic8.process(pdm + consumed, length, cicOutput);
+        } else {
+            samples = cic16.process(pdm + consumed, length, cicOutput);
+        }
+
+        consumed += length;
+
+        for (unsigned int i = 0; i < samples; i++) {
+            if (!halfBand.push(cicOutput[i], hb))
+                continue;
+
+            if (rate == PCM_8KHZ ? compensationDecimator.push(hb, out) : compensation.push(hb, out)) {
+                pcm[produced++] = out;
+            }
+        }
+    }
+
+    return consumed;
+}
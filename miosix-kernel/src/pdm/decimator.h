@@ -0,0 +1,268 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+#include "pdm_decimator.h"
+
+/**
+ * Output sample rates supported by the decimation chain.
+ * The values are the nominal rates in Hz: the PDM clock must be the rate multiplied by the
+ * decimation factor of the chain (see DecimationChain::getDecimation).
+ */
+typedef enum {
+    PCM_48KHZ = 48000,
+    PCM_32KHZ = 32000,
+    PCM_16KHZ = 16000,
+    PCM_8KHZ = 8000
+} PcmRate;
+
+
+/**
+ * Round a Q15 accumulator to a 16 bit sample, saturating on overflow.
+ */
+static inline short q15Round(int32_t acc) {
+    return saturate16((acc + (1 << 14)) >> 15);
+}
+
+
+/**
+ * Linear phase FIR filter followed by decimation.
+ * The filter is polyphase in the sense that it only computes the outputs which are kept:
+ * the other input samples are just stored in the delay line.
+ *
+ * @tparam Taps     number of coefficients (odd, symmetric)
+ * @tparam Factor   decimation factor
+ */
+template<unsigned int Taps, unsigned int Factor>
+class FirDecimator {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param coefficients  symmetric Q15 impulse response of length Taps (32 bit wide, so
+     *                      that gains slightly greater than 1 can be represented)
+     */
+    explicit FirDecimator(const int32_t *coefficients) : coefficients(coefficients) {
+        reset();
+    }
+
+
+    /**
+     * Clear the delay line.
+     */
+    void reset() {
+        for (unsigned int i = 0; i < 2 * Taps; i++) {
+            history[i] = 0;
+        }
+
+        position = 0;
+        phase = 0;
+    }
+
+
+    /**
+     * Feed a sample to the filter.
+     *
+     * @param value     input sample
+     * @param output    filtered sample (only written if available)
+     * @return true if an output sample has been produced
+     */
+    bool push(short value, short &output) {
+        // The delay line is mirrored, so that the last Taps samples are always contiguous
+        history[position] = value;
+        history[position + Taps] = value;
+        position = position + 1 < Taps ? position + 1 : 0;
+
+        if (++phase < Factor)
+            return false;
+
+        phase = 0;
+
+        // history[position] is the oldest sample. Exploit the symmetry of the coefficients.
+        const short *x = &history[position];
+        int32_t acc = coefficients[Taps / 2] * x[Taps / 2];
+
+        for (unsigned int i = 0; i < Taps / 2; i++) {
+            acc += coefficients[i] * (x[i] + x[Taps - 1 - i]);
+        }
+
+        output = q15Round(acc);
+        return true;
+    }
+
+
+private:
+    const int32_t *coefficients;
+    short history[2 * Taps];
+    unsigned int position;
+    unsigned int phase;
+};
+
+
+/**
+ * Half-band FIR filter followed by decimation by 2.
+ * Every other coefficient of a half-band filter is zero and the central one is 0.5, so only
+ * the odd taps are stored and evaluated.
+ *
+ * @tparam Taps     number of coefficients (must be in the form 4k - 1)
+ */
+template<unsigned int Taps>
+class HalfBandDecimator {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param coefficients  Q15 odd taps on one side of the center, the nearest first
+     *                      ((Taps + 1) / 4 elements)
+     */
+    explicit HalfBandDecimator(const short *coefficients) : coefficients(coefficients) {
+        reset();
+    }
+
+
+    /**
+     * Clear the delay line.
+     */
+    void reset() {
+        for (unsigned int i = 0; i < 2 * Taps; i++) {
+            history[i] = 0;
+        }
+
+        position = 0;
+        phase = 0;
+    }
+
+
+    /**
+     * Feed a sample to the filter.
+     *
+     * @param value     input sample
+     * @param output    filtered sample (only written if available)
+     * @return true if an output sample has been produced
+     */
+    bool push(short value, short &output) {
+        history[position] = value;
+        history[position + Taps] = value;
+        position = position + 1 < Taps ? position + 1 : 0;
+
+        if (++phase < 2)
+            return false;
+
+        phase = 0;
+
+        const short *center = &history[position + Taps / 2];
+        int32_t acc = (int32_t) *center << 14;
+
+        for (unsigned int i = 0; i < (Taps + 1) / 4; i++) {
+            acc += (int32_t) coefficients[i] * (center[-(2 * (int) i + 1)] + center[2 * i + 1]);
+        }
+
+        output = q15Round(acc);
+        return true;
+    }
+
+
+private:
+    const short *coefficients;
+    short history[2 * Taps];
+    unsigned int position;
+    unsigned int phase;
+};
+
+
+/**
+ * PDM to PCM conversion chain.
+ * The PDM stream is first decimated by a 4th order CIC filter, then by a half-band FIR filter
+ * and finally goes through a FIR filter compensating the passband droop of the CIC, which
+ * also decimates by 2 when the lowest rate is selected:
+ *
+ *  48 kHz: CIC /8  -> half-band /2 -> compensation /1    (768 kHz PDM clock)
+ *  32 kHz: CIC /8  -> half-band /2 -> compensation /1    (512 kHz PDM clock)
+ *  16 kHz: CIC /16 -> half-band /2 -> compensation /1    (512 kHz PDM clock)
+ *   8 kHz: CIC /16 -> half-band /2 -> compensation /2    (512 kHz PDM clock)
+ *
+ * The output is scaled as the one of a CIC decimating by 16 (full scale PDM is 65536).
+ */
+class DecimationChain {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param rate  output sample rate
+     */
+    explicit DecimationChain(PcmRate rate);
+
+
+    /**
+     * Get the overall decimation factor.
+     *
+     * @param rate  output sample rate
+     * @return number of PDM bits for each PCM sample
+     */
+    static constexpr unsigned int getDecimation(PcmRate rate) {
+        return rate == PCM_8KHZ ? 64 : (rate == PCM_16KHZ ? 32 : 16);
+    }
+
+
+    /**
+     * Reset the state of all the filters.
+     */
+    void reset();
+
+
+    /**
+     * Get the output sample rate.
+     *
+     * @return nominal sample rate in Hz
+     */
+    unsigned int getSampleRate();
+
+
+    /**
+     * Convert PDM words to PCM samples, stopping as soon as the output buffer is full.
+     * Each PDM word produces at most one PCM sample.
+     *
+     * @param pdm           PDM words
+     * @param words         number of PDM words
+     * @param pcm           output buffer
+     * @param maxSamples    output buffer capacity
+     * @param produced      number of PCM samples written to the output buffer
+     * @return number of PDM words consumed
+     */
+    unsigned int process(const unsigned short *pdm, unsigned int words,
+                         short *pcm, unsigned int maxSamples, unsigned int &produced);
+
+
+private:
+    static const unsigned int blockSize = 32;   // PDM words converted by the CIC at a time
+
+    PcmRate rate;
+    PdmDecimator<4, 8> cic8;
+    PdmDecimator<4, 16> cic16;
+    short cicOutput[2 * blockSize];
+    HalfBandDecimator<35> halfBand;
+    FirDecimator<15, 1> compensation;
+    FirDecimator<43, 2> compensationDecimator;
+};
+
+#endif /* DECIMATOR_H */
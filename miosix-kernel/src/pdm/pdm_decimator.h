@@ -0,0 +1,245 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef PDM_DECIMATOR_H
+#define PDM_DECIMATOR_H
+
+#include <stdint.h>
+
+/**
+ * Convert a value to a 16 bit sample, saturating on overflow.
+ */
+static inline short saturate16(int32_t value) {
+    if (value > 32767)
+        return 32767;
+
+    if (value < -32768)
+        return -32768;
+
+    return (short) value;
+}
+
+
+/**
+ * Compile time base 2 logarithm.
+ */
+template<unsigned int N>
+struct Log2 {
+    static const unsigned int value = 1 + Log2<N / 2>::value;
+};
+
+template<>
+struct Log2<1> {
+    static const unsigned int value = 0;
+};
+
+
+/**
+ * Lookup tables of the byte-wise CIC integration, shared by all the decimators with the same
+ * order.
+ *
+ * @tparam Order    number of integrator stages
+ */
+template<unsigned int Order>
+class PdmTables {
+public:
+
+    /**
+     * Build the tables, if not already done.
+     */
+    static void init() {
+        if (ready)
+            return;
+
+        // step[d] = C(7 + d, d)
+        step[0] = 1;
+
+        for (unsigned int d = 1; d < Order; d++) {
+            step[d] = step[d - 1] * (7 + d) / d;
+        }
+
+        // Contribution of each byte, starting from all-zero registers
+        for (unsigned int byte = 0; byte < 256; byte++) {
+            int32_t reg[Order] = {};
+
+            for (unsigned int i = 0; i < 8; i++) {
+                reg[0] += (byte >> (7u - i)) & 1u ? 1 : -1;
+
+                for (unsigned int j = 1; j < Order; j++) {
+                    reg[j] += reg[j - 1];
+                }
+            }
+
+            for (unsigned int j = 0; j < Order; j++) {
+                contribution[byte][j] = reg[j];
+            }
+        }
+
+        ready = true;
+    }
+
+    static int16_t contribution[256][Order];    // Integrator values after a byte, from zero
+    static uint32_t step[Order];                // Coupling between the integrators over 8 steps
+
+private:
+    static bool ready;
+};
+
+template<unsigned int Order>
+int16_t PdmTables<Order>::contribution[256][Order];
+
+template<unsigned int Order>
+uint32_t PdmTables<Order>::step[Order];
+
+template<unsigned int Order>
+bool PdmTables<Order>::ready = false;
+
+
+/**
+ * CIC decimator converting a PDM stream to PCM samples.
+ *
+ * The PDM stream is processed one byte at a time: without input, 8 integration steps map the
+ * registers to reg[k] += sum_{j<k} C(7 + k - j, k - j) * reg[j], while the contribution of the
+ * input byte is read from a precomputed table. The result is bit-exact with the integration of
+ * one bit at a time.
+ *
+ * Each instance has its own filter state, so that more PDM streams can be processed at the
+ * same time. The output is scaled as the one of a 4th order CIC decimating by 16, that is a
+ * full scale PDM stream corresponds to 65536 (saturated to the 16 bit range).
+ *
+ * @tparam Order        number of integrator and comb stages
+ * @tparam Decimation   decimation factor (power of 2, at least 8, with Decimation^Order at
+ *                      most 2^30)
+ */
+template<unsigned int Order, unsigned int Decimation>
+class PdmDecimator {
+    static_assert(Order >= 1 && Order <= 6, "Unsupported CIC order");
+    static_assert(Decimation >= 8 && (Decimation & (Decimation - 1)) == 0,
+                  "The decimation factor must be a power of 2, at least 8");
+
+public:
+
+    /**
+     * Constructor
+     */
+    PdmDecimator() {
+        PdmTables<Order>::init();
+        reset();
+    }
+
+
+    /**
+     * Clear the filter state.
+     * Must be called when the PDM stream is interrupted, before processing the new one.
+     */
+    void reset() {
+        for (unsigned int i = 0; i < Order; i++) {
+            intReg[i] = 0;
+            combReg[i] = 0;
+        }
+
+        phase = 0;
+    }
+
+
+    /**
+     * Convert a block of PDM words.
+     * If the decimation factor is greater than 16, the bits of a word which are not enough for
+     * a sample are kept in the filter state and used by the next call.
+     *
+     * @param pdm       PDM words, the most significant bit of each being the oldest
+     * @param words     number of PDM words to be processed
+     * @param pcm       output buffer (at least words * 16 / Decimation + 1 elements)
+     * @param stride    distance between two consecutive words of the stream, used to process
+     *                  a single channel of an interleaved buffer
+     * @return number of PCM samples written
+     */
+    unsigned int process(const unsigned short *pdm, unsigned int words, short *pcm,
+                         unsigned int stride = 1) {
+        unsigned int produced = 0;
+
+        for (unsigned int i = 0; i < words; i++, pdm += stride) {
+            integrate(*pdm >> 8u);
+
+            if (++phase == Decimation / 8) {
+                phase = 0;
+                pcm[produced++] = comb();
+            }
+
+            integrate(*pdm & 0xffu);
+
+            if (++phase == Decimation / 8) {
+                phase = 0;
+                pcm[produced++] = comb();
+            }
+        }
+
+        return produced;
+    }
+
+
+private:
+
+    /**
+     * Feed 8 PDM bits to the integrator cascade.
+     */
+    void integrate(unsigned int byte) {
+        const int16_t *contribution = PdmTables<Order>::contribution[byte];
+
+        // Update the last stages first, as they depend on the previous values of the others
+        for (unsigned int k = Order; k-- > 0;) {
+            uint32_t value = intReg[k] + contribution[k];
+
+            for (unsigned int j = 0; j < k; j++) {
+                value += PdmTables<Order>::step[k - j] * intReg[j];
+            }
+
+            intReg[k] = value;
+        }
+    }
+
+
+    /**
+     * Apply the comb stages (with delay 1) to the output of the integrators.
+     */
+    short comb() {
+        uint32_t value = intReg[Order - 1];
+
+        for (unsigned int i = 0; i < Order; i++) {
+            uint32_t delayed = combReg[i];
+            combReg[i] = value;
+            value -= delayed;
+        }
+
+        return saturate16(((int32_t) value >> scaleDown) * (1 << scaleUp));
+    }
+
+
+    // The CIC gain is Decimation^Order: shift the output to a 2^16 gain
+    static const unsigned int gainBits = Order * Log2<Decimation>::value;
+    static const unsigned int scaleUp = gainBits < 16 ? 16 - gainBits : 0;
+    static const unsigned int scaleDown = gainBits > 16 ? gainBits - 16 : 0;
+
+    // The output of the comb stages, up to 2^gainBits in magnitude, must fit the 32 bit registers
+    static_assert(gainBits <= 30, "The CIC gain doesn't fit the 32 bit registers: reduce the order or the decimation");
+
+    uint32_t intReg[Order];     // Integrator registers (modulo 2^32 arithmetic)
+    uint32_t combReg[Order];    // Comb delay registers
+    unsigned int phase;         // Number of bytes integrated since the last output
+};
+
+#endif /* PDM_DECIMATOR_H */
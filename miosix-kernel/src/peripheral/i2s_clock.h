@@ -0,0 +1,141 @@
+/**************************************************************************
+ * Copyright (C) 2019 Michele Scuttari, Marina Nikolic                    *
+ *                                                                        *
+ * This program is free software: you can redistribute it and/or modify   *
+ * it under the terms of the GNU General Public License as published by   *
+ * the Free Software Foundation, either version 3 of the License, or      *
+ * (at your option) any later version.                                    *
+ *                                                                        *
+ * This program is distributed in the hope that it will be useful,        *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ * GNU General Public License for more details.                           *
+ *                                                                        *
+ * You should have received a copy of the GNU General Public License      *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ **************************************************************************/
+
+#ifndef I2S_CLOCK_H
+#define I2S_CLOCK_H
+
+#include "../pdm/decimator.h"
+
+/**
+ * Configuration of the I2S clock, used as PDM clock for the microphone.
+ * The PLLI2S is fed with 1 MHz (HSE / PLL_M) and the I2S works in master receive mode with
+ * 16 bit frames and master clock output enabled, so (see chapters 7.3.23 and 28.4.4 of the
+ * datasheet):
+ *
+ *  I2SCLK = 1 MHz * PLLI2S_N / PLLI2S_R
+ *  PDM clock = I2SCLK / (8 * (2 * I2SDIV + ODD))
+ */
+struct I2sClockConfig {
+    PcmRate rate;           // Nominal PCM sample rate
+    unsigned int plln;      // PLLI2S multiplication factor (VCO at 100 - 432 MHz)
+    unsigned int pllr;      // PLLI2S division factor (2 - 7)
+    unsigned int i2sdiv;    // I2S prescaler (2 - 255)
+    unsigned int odd;       // I2S prescaler odd factor (0 - 1)
+
+    /**
+     * Get the PDM clock frequency.
+     *
+     * @return frequency in Hz
+     */
+    constexpr double getPdmClock() const {
+        return 1000000.0 * plln / pllr / (8 * (2 * i2sdiv + odd));
+    }
+
+    /**
+     * Get the PCM sample rate actually obtained.
+     *
+     * @return sample rate in Hz
+     */
+    constexpr double getExactRate() const {
+        return getPdmClock() / DecimationChain::getDecimation(rate);
+    }
+
+    /**
+     * Get the error of the sample rate with respect to the nominal one.
+     *
+     * @return error in parts per million
+     */
+    constexpr double getPpmError() const {
+        return (getExactRate() / rate - 1) * 1000000.0;
+    }
+
+    /**
+     * Check that the register values are within the ranges allowed by the hardware and that
+     * the rate is accurate enough.
+     *
+     * @return true if the configuration is valid
+     */
+    constexpr bool isValid() const {
+        return plln >= 100 && plln <= 432 && pllr >= 2 && pllr <= 7 &&
+               i2sdiv >= 2 && i2sdiv <= 255 && odd <= 1 &&
+               getPpmError() > -maxPpmError && getPpmError() < maxPpmError;
+    }
+
+    static constexpr double maxPpmError = 500;
+};
+
+
+/**
+ * Clock configurations for each sample rate, found by exhaustive search of the lowest error.
+ *
+ *  Rate    PDM clock       Exact rate      Error
+ *  48 kHz  768115.9 Hz     48007.25 Hz     +151 ppm
+ *  32 kHz  512019.2 Hz     32001.20 Hz     +37.6 ppm
+ *  16 kHz  512019.2 Hz     16000.60 Hz     +37.6 ppm
+ *   8 kHz  512019.2 Hz      8000.30 Hz     +37.6 ppm
+ */
+constexpr I2sClockConfig i2sClockTable[] = {
+    { PCM_48KHZ, 424, 3, 11, 1 },
+    { PCM_32KHZ, 213, 2, 13, 0 },
+    { PCM_16KHZ, 213, 2, 13, 0 },
+    { PCM_8KHZ,  213, 2, 13, 0 }
+};
+
+constexpr unsigned int i2sClockTableSize = sizeof(i2sClockTable) / sizeof(i2sClockTable[0]);
+
+
+/**
+ * Check that all the configurations of the table are valid.
+ */
+constexpr bool isI2sClockTableValid(unsigned int index = 0) {
+    return index == i2sClockTableSize ||
+           (i2sClockTable[index].isValid() && isI2sClockTableValid(index + 1));
+}
+
+static_assert(isI2sClockTableValid(), "Invalid I2S clock configuration");
+
+
+/**
+ * Get the clock configuration of a sample rate.
+ * Can be evaluated at compile time.
+ *
+ * @param rate      PCM sample rate
+ * @param index     first table entry to be searched
+ * @return clock configuration (the last of the table if the rate is not found)
+ */
+constexpr const I2sClockConfig& getI2sClockConfig(PcmRate rate, unsigned int index = 0) {
+    return index + 1 >= i2sClockTableSize || i2sClockTable[index].rate == rate ?
+           i2sClockTable[index] : getI2sClockConfig(rate, index + 1);
+}
+
+
+/**
+ * Clock configuration of a sample rate known at compile time
+ *
+ * @tparam Rate     PCM sample rate
+ */
+template<PcmRate Rate>
+struct I2sClock {
+    static_assert(getI2sClockConfig(Rate).rate == Rate, "No I2S clock configuration for the sample rate");
+
+    static constexpr unsigned int plln = getI2sClockConfig(Rate).plln;
+    static constexpr unsigned int pllr = getI2sClockConfig(Rate).pllr;
+    static constexpr unsigned int i2sdiv = getI2sClockConfig(Rate).i2sdiv;
+    static constexpr unsigned int odd = getI2sClockConfig(Rate).odd;
+};
+
+#endif /* I2S_CLOCK_H */
@@ -17,6 +17,9 @@
  **************************************************************************/
 
 #include "microphone.h"
+#include "i2s_clock.h"
+#include "../audio/pcm_ring.h"
+#include "../benchmark/cycles.h"
 #include <miosix.h>
 #include <kernel/scheduler/scheduler.h>
 
@@ -29,31 +32,61 @@ static const int bufferSize = 512;
 static const int bufferNumber = 2;
 static BufferQueue<unsigned short, bufferSize, bufferNumber> *bq;
 
+static const I2sClockConfig *clockConfig;   // Current PDM clock configuration
+static unsigned int pdmWordRate;            // PDM words received per second
+
 static Thread *waiting;
 static bool enobuf = true;
 static bool recording;                      // Whether the recording is in progress or not
+static bool alive;                          // Whether the hardware and the threads are set up
+static bool captureIdle;                    // Whether the transcoding thread is waiting to be resumed
+static bool callbackRunning;                // Whether the callback is being executed
+
+static bool awaitingFirstFrame;             // Whether the start latency has still to be measured
+static unsigned int startCycle;             // Cycle counter value when the recording was started
+
+static MicrophoneStats stats;               // Capture statistics
+static bool starved;                        // Whether the DMA stopped because of the lack of free buffers
+static long long starvationTick;            // When the DMA stopped
 
 static void* mainLoopLauncher(void* arg);   // Used for mainLoop thread creation.
 static void mainLoop();                     // Function that manages the transcoding
 static pthread_t mainLoopThread;            // Thread taking care of transcoding
 
-// Double buffering
-static short *readyBuffer;
-static short *processingBuffer;
+// PCM history, from which the overlapping frames are taken
+static PcmRing *ring;
+static const short *readyFrame;
+static unsigned long long readyFrameStart;  // Index of the first sample of readyFrame
+static volatile unsigned int samplesWritten;    // Lowest 32 bits of the samples committed to the ring
 static bool isBufferReady;
 
-static unsigned int PCMsize;    // How many PCM samples to collect before executing the callback
-static unsigned int PCMindex;   // Transcoding progress index
+static unsigned int PCMsize;    // How many PCM samples to pass to the callback
+
+static DecimationChain *decimator;                                  // PDM to PCM conversion filters
+static PcmRate decimatorRate;                                       // Output rate of the decimator
 
-static bool processPdm(const unsigned short *pdmBuffer, int size);              // Convert PDM buffer to PCM samples
-static short PDMFilter(const unsigned short* pdmBuffer, unsigned int index);    // Get single PCM sample from PDM values
+static unsigned int preRollTime;            // Pre-roll duration, in milliseconds
+static bool freezeRequested;                // Whether the transcoding thread has to freeze the pre-roll
+static unsigned int frozenSamples;          // Number of samples frozen by the last request
+static void freezeRing();                   // Serve the freeze request
+static void processPdm(const unsigned short *pdmBuffer, int size);  // Convert PDM buffer to PCM samples
+static void frameReady(const short *frame, unsigned long long start);   // Hand a frame to the callback thread
 
-static void* callbackLauncher(void* arg);               // Used for execCallback thread creation
-static void execCallback();                             // Function that executes the callback when the PCM samples are ready
-static function<void (short*, unsigned int)> callback;  // Function called when the PCM samples are ready to be processed
+static void* callbackLauncher(void* arg);   // Used for execCallback thread creation
+static void execCallback();                 // Function that executes the callback when the PCM samples are ready
+static pthread_t callbackThread;            // Thread executing the callbacks
+static void (*callback)(void*, const short*, unsigned int, unsigned long long);   // Sink of the PCM frames
+static void *callbackContext;               // First argument of the callback
+static PcmHandler monitor;                  // Stage receiving the PCM samples as they are produced
+static void *monitorContext;                // First argument of the monitor
 
 static pthread_mutex_t bufMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t cbackExecCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t stateCond = PTHREAD_COND_INITIALIZER;    // Signals pause, resume and release
+
+static void setup(PcmRate rate);    // Configure the hardware and create the threads
+static void configureClock(const I2sClockConfig &config);  // Set the PDM clock
+static void stopDma();          // Stop the transfers and discard the PDM data
 
 
 /**
@@ -64,6 +97,9 @@ static void IRQdmaRefill() {
     
     if (!bq->tryGetWritableBuffer(buffer)) {
         enobuf = true;
+        starved = true;
+        starvationTick = getTick();
+        stats.dmaStarvations++;
         return;
     }
     
@@ -82,6 +118,21 @@ static void IRQdmaRefill() {
 
 static void dmaRefill() {
     FastInterruptDisableLock dLock;
+
+    if (starved) {
+        // The microphone data received while the DMA was stopped has been lost
+        long long elapsed = getTick() - starvationTick;
+        long long blockTicks = (long long) bufferSize * TICK_FREQ;
+        unsigned int lost = (elapsed * pdmWordRate + blockTicks - 1) / blockTicks;
+        stats.pdmBlocksLost += lost > 0 ? lost : 1;
+        starved = false;
+    }
+
+    // Clear the I2S overrun caused by the data not read while the DMA was stopped,
+    // otherwise the interface would not receive anything else
+    static_cast<void>(SPI2->DR);
+    static_cast<void>(SPI2->SR);
+
     IRQdmaRefill();
 }
 
@@ -145,15 +196,221 @@ void __attribute__((used)) I2SdmaHandlerImpl() {
 }
 
 
-bool Microphone::start(function<void (short*, unsigned int)> cb, unsigned int buffsize) {
+bool Microphone::startSink(FrameHandler handler, void *context, unsigned int frameSize,
+                           unsigned int hopSize, PcmRate rate) {
     if (recording)
         return false;
 
-    callback = cb;
-    PCMsize = buffsize;
+    if (hopSize == 0 || hopSize > frameSize || frameSize % hopSize != 0)
+        return false;
+
+    // The start latency includes the setup of the first start
+    if (!alive)
+        cycleCounterInit();
+
+    startCycle = cycleCount();
+
+    // The hardware, the threads and the buffers are kept between sessions, so that only the
+    // first start (or a change of configuration) pays the setup time
+    const I2sClockConfig &config = getI2sClockConfig(rate);
+
+    if (!alive) {
+        setup(rate);
+
+    } else if (config.getPdmClock() != clockConfig->getPdmClock()) {
+        configureClock(config);
+        delayMs(10);
+    }
+
+    unsigned int retention = preRollTime * rate / 1000;
+
+    if (ring == nullptr || ring->getFrameSize() != frameSize || ring->getHopSize() != hopSize ||
+        ring->getRetention() != retention) {
+        delete ring;
+        ring = new PcmRing(frameSize, hopSize, retention);
+    }
+
+    if (decimator == nullptr || decimatorRate != rate) {
+        delete decimator;
+        decimator = new DecimationChain(rate);
+        decimatorRate = rate;
+    }
+
+    // Resume the transcoding thread, which is idle at this point
+    pthread_mutex_lock(&bufMutex);
+
+    callback = handler;
+    callbackContext = context;
+    PCMsize = frameSize;
+    ring->reset();
+    samplesWritten = 0;
+    decimator->reset();
+    stats = MicrophoneStats();
+    isBufferReady = false;
+    awaitingFirstFrame = true;
     recording = true;
-    readyBuffer = (short *) malloc(buffsize * sizeof(short));
-    processingBuffer = (short *) malloc(buffsize * sizeof(short));
+
+    pthread_cond_broadcast(&stateCond);
+    pthread_mutex_unlock(&bufMutex);
+
+    return true;
+}
+
+
+void Microphone::stop() {
+    pthread_mutex_lock(&bufMutex);
+
+    if (!recording) {
+        pthread_mutex_unlock(&bufMutex);
+        return;
+    }
+
+    // Wait for the transcoding thread to stop the DMA and for the last callback to end
+    recording = false;
+
+    while (!captureIdle || callbackRunning)
+        pthread_cond_wait(&stateCond, &bufMutex);
+
+    // Drop the frame not yet taken by the callback thread
+    isBufferReady = false;
+
+    pthread_mutex_unlock(&bufMutex);
+}
+
+
+void Microphone::release() {
+    stop();
+
+    if (!alive)
+        return;
+
+    // Terminate the threads
+    pthread_mutex_lock(&bufMutex);
+    alive = false;
+    pthread_cond_broadcast(&stateCond);
+    pthread_cond_broadcast(&cbackExecCond);
+    pthread_mutex_unlock(&bufMutex);
+
+    pthread_join(mainLoopThread, nullptr);
+    pthread_join(callbackThread, nullptr);
+
+    // Reset the configuration registers to stop the hardware
+    NVIC_DisableIRQ(DMA1_Stream3_IRQn);
+    delete bq;
+    SPI2->I2SCFGR = 0;
+
+    {
+        FastInterruptDisableLock dLock;
+        RCC->CR &= ~RCC_CR_PLLI2SON;
+    }
+
+    delete ring;
+    ring = nullptr;
+    delete decimator;
+    decimator = nullptr;
+}
+
+
+void Microphone::setMonitorHandler(PcmHandler handler, void *context) {
+    pthread_mutex_lock(&bufMutex);
+    monitor = handler;
+    monitorContext = context;
+    pthread_mutex_unlock(&bufMutex);
+}
+
+
+void Microphone::setPreRoll(unsigned int milliseconds) {
+    preRollTime = milliseconds;
+}
+
+
+unsigned int Microphone::freezePreRoll() {
+    pthread_mutex_lock(&bufMutex);
+
+    if (ring == nullptr) {
+        pthread_mutex_unlock(&bufMutex);
+        return 0;
+    }
+
+    // The ring is frozen by its producer, that is the transcoding thread, unless it is idle
+    freezeRequested = true;
+
+    while (freezeRequested && !captureIdle)
+        pthread_cond_wait(&stateCond, &bufMutex);
+
+    if (freezeRequested) {
+        frozenSamples = ring->freeze();
+        freezeRequested = false;
+    }
+
+    unsigned int count = frozenSamples;
+    pthread_mutex_unlock(&bufMutex);
+
+    return count;
+}
+
+
+const short* Microphone::getPreRoll(unsigned int &count) {
+    if (ring == nullptr) {
+        count = 0;
+        return nullptr;
+    }
+
+    return ring->getRetained(count);
+}
+
+
+void Microphone::releasePreRoll(unsigned int count) {
+    ring->release(count);
+}
+
+
+MicrophoneStats Microphone::getStats() {
+    FastInterruptDisableLock dLock;
+    return stats;
+}
+
+
+unsigned int Microphone::getSampleRate() {
+    return decimator ? decimator->getSampleRate() : 0;
+}
+
+
+float Microphone::getExactSampleRate() {
+    return decimator ? getI2sClockConfig(decimatorRate).getExactRate() : 0;
+}
+
+
+bool MicrophoneSource::startSink(FrameHandler handler, void *context, unsigned int frameSize,
+                                 unsigned int hopSize, PcmRate rate) {
+    return Microphone::startSink(handler, context, frameSize, hopSize, rate);
+}
+
+
+void MicrophoneSource::stop() {
+    Microphone::stop();
+}
+
+
+unsigned int MicrophoneSource::getSampleRate() {
+    return Microphone::getSampleRate();
+}
+
+
+float MicrophoneSource::getExactSampleRate() {
+    return Microphone::getExactSampleRate();
+}
+
+
+void MicrophoneSource::setMonitorHandler(PcmHandler handler, void *context) {
+    Microphone::setMonitorHandler(handler, context);
+}
+
+
+void setup(PcmRate rate) {
+    bq = new BufferQueue<unsigned short, bufferSize, bufferNumber>();
+    enobuf = true;
+    starved = false;
 
     {
         FastInterruptDisableLock dLock;
@@ -173,66 +430,81 @@ bool Microphone::start(function<void (short*, unsigned int)> cb, unsigned int bu
         dout::mode(Mode::ALTERNATE);
         dout::alternateFunction(5);
         dout::speed(Speed::_50MHz);
-
-        // Set the 32 kHz sampling rate
-        // (see chapters 7.3.23 and 28.4.4 of the datasheet for further details)
-
-        const unsigned int PLLI2S_N = 213u;
-        const unsigned int PLLI2S_R = 2u;
-        const unsigned int I2SDIV = 13u;
-
-        SPI2->I2SPR = (I2SDIV << 0u);
-
-        RCC->PLLI2SCFGR = (PLLI2S_R << 28u) | (PLLI2S_N << 6u);
-
-        // Enable I2S
-        RCC->CR |= RCC_CR_PLLI2SON;
     }
 
-    // Wait for PLL to lock
-    while ((RCC->CR & RCC_CR_PLLI2SRDY) == 0);
-
     // RX buffer not empty interrupt enable
     SPI2->CR2 = SPI_CR2_RXDMAEN;
 
-    // Enable the master clock for I2S
-    SPI2->I2SPR |= SPI_I2SPR_MCKOE;
-
     // Configure SPI
     SPI2->I2SCFGR = SPI_I2SCFGR_I2SMOD |                            // I2S mode selected
-                    SPI_I2SCFGR_I2SE |                              // I2S enabled
                     SPI_I2SCFGR_I2SCFG_0 | SPI_I2SCFGR_I2SCFG_1;    // Mode: master receive
 
+    // Set the sampling rate and enable I2S
+    configureClock(getI2sClockConfig(rate));
+
     // High priority for DMA
     NVIC_SetPriority(DMA1_Stream3_IRQn, 2);
+    NVIC_EnableIRQ(DMA1_Stream3_IRQn);
 
-    // Wait for the microphone to enable
+    // Wait for the microphone to enable. The clock is kept running while the recording
+    // is paused, so this is needed only once.
     delayMs(10);
 
+    alive = true;
+    captureIdle = false;
     pthread_create(&mainLoopThread, nullptr, mainLoopLauncher, nullptr);
-    return true;
+    pthread_create(&callbackThread, nullptr, callbackLauncher, nullptr);
 }
 
 
-void Microphone::stop() {
-    // Stop the software
-    recording = false;
-    
-    // Wait for the last PCM processing to end
-    pthread_join(mainLoopThread, nullptr);
-    
-    // Reset the configuration registers to stop the hardware
-    NVIC_DisableIRQ(DMA1_Stream3_IRQn);
-    delete bq;
-    SPI2->I2SCFGR = 0;
-    
+void configureClock(const I2sClockConfig &config) {
+    // The PLL can't be configured while running
+    SPI2->I2SCFGR &= ~SPI_I2SCFGR_I2SE;
+
     {
         FastInterruptDisableLock dLock;
         RCC->CR &= ~RCC_CR_PLLI2SON;
     }
 
-    free(readyBuffer);
-    free(processingBuffer);
+    while (RCC->CR & RCC_CR_PLLI2SRDY);
+
+    // Set the prescaler, enabling the master clock for I2S
+    // (see chapters 7.3.23 and 28.4.4 of the datasheet for further details)
+    SPI2->I2SPR = (config.i2sdiv << 0u) | (config.odd ? SPI_I2SPR_ODD : 0) | SPI_I2SPR_MCKOE;
+
+    {
+        FastInterruptDisableLock dLock;
+        RCC->PLLI2SCFGR = (config.pllr << 28u) | (config.plln << 6u);
+        RCC->CR |= RCC_CR_PLLI2SON;
+    }
+
+    // Wait for PLL to lock
+    while ((RCC->CR & RCC_CR_PLLI2SRDY) == 0);
+
+    // Enable I2S
+    SPI2->I2SCFGR |= SPI_I2SCFGR_I2SE;
+
+    clockConfig = &config;
+    pdmWordRate = config.getPdmClock() / 16 + 0.5;
+}
+
+
+void stopDma() {
+    FastInterruptDisableLock dLock;
+
+    DMA1_Stream3->CR = 0;
+    while (DMA1_Stream3->CR & DMA_SxCR_EN);
+
+    // Discard the transfer completed in the meanwhile, if any
+    DMA1->LIFCR = DMA_LIFCR_CTCIF3  |
+                  DMA_LIFCR_CTEIF3  |
+                  DMA_LIFCR_CDMEIF3 |
+                  DMA_LIFCR_CFEIF3;
+    NVIC_ClearPendingIRQ(DMA1_Stream3_IRQn);
+
+    bq->reset();
+    enobuf = true;
+    starved = false;
 }
 
 
@@ -244,55 +516,37 @@ void* mainLoopLauncher(void* arg) {
 
 void mainLoop() {
     waiting = Thread::getCurrentThread();
-    pthread_t cback;
-    bq = new BufferQueue<unsigned short, bufferSize, bufferNumber>();
-    NVIC_EnableIRQ(DMA1_Stream3_IRQn);
-    
-    // Create the thread that will execute the callbacks 
-    pthread_create(&cback, nullptr, callbackLauncher, nullptr);
-    isBufferReady = false;
-    
-    // Variable used for swap of processing and ready buffer
-    short *tmp;
 
-    while (recording) {
-        PCMindex = 0;
+    while (true) {
+        // Wait to be resumed
+        pthread_mutex_lock(&bufMutex);
+        captureIdle = true;
+        pthread_cond_broadcast(&stateCond);
+
+        while (alive && !recording)
+            pthread_cond_wait(&stateCond, &bufMutex);
+
+        captureIdle = false;
+        bool quit = !alive;
+        pthread_mutex_unlock(&bufMutex);
+
+        if (quit)
+            break;
 
-        // Process any new chunk of PDM samples
-        for (;;) {
+        while (recording) {
             if (enobuf) {
                 enobuf = false;
                 dmaRefill();
             }
-            
-            if (processPdm(getReadableBuffer(), bufferSize)){
-                // Transcode until the specified number of PCM samples
-                break;
-            }
-            
+
+            // Transcode the whole chunk of PDM samples. The callback is triggered
+            // each time a hop has been collected.
+            processPdm(getReadableBuffer(), bufferSize);
             bufferEmptied();
         }
-        
-        // Swap the ready and the processing buffer: allows double buffering
-        // on the callback side
 
-        tmp = readyBuffer;
-
-        // Start critical section
-        pthread_mutex_lock(&bufMutex);
-
-        readyBuffer = processingBuffer;
-        isBufferReady = true;
-
-        pthread_cond_broadcast(&cbackExecCond);
-        pthread_mutex_unlock(&bufMutex);
-        // End critical section
-
-        processingBuffer = tmp;
+        stopDma();
     }
-    
-    pthread_cond_broadcast(&cbackExecCond);
-    pthread_join(cback, nullptr);
 }
 
 
@@ -303,60 +557,108 @@ void* callbackLauncher(void* arg) {
 
 
 void execCallback() {
-    while (recording) {
+    while (true) {
         pthread_mutex_lock(&bufMutex);
         
-        while (recording && !isBufferReady)
+        while (alive && !isBufferReady)
             pthread_cond_wait(&cbackExecCond, &bufMutex);
 
-        callback(readyBuffer, PCMsize);
+        if (!alive) {
+            pthread_mutex_unlock(&bufMutex);
+            break;
+        }
+
+        const short *frame = readyFrame;
+        unsigned long long frameStart = readyFrameStart;
         isBufferReady = false;
+        callbackRunning = true;
+
+        if (awaitingFirstFrame) {
+            stats.startLatency = (cycleCount() - startCycle) / (SystemCoreClock / 1000000);
+            awaitingFirstFrame = false;
+        }
+
+        pthread_mutex_unlock(&bufMutex);
+
+        // The frame is read directly from the PCM history, which is not locked: the
+        // transcoding goes on while the callback is executed
+        unsigned int start = cycleCount();
+        callback(callbackContext, frame, PCMsize, frameStart);
+        unsigned int duration = (cycleCount() - start) / (SystemCoreClock / 1000000);
+
+        // Once a whole ring has been committed after the first sample of the frame, the
+        // transcoding is writing over it
+        bool torn = samplesWritten - (unsigned int) frameStart >= ring->getCapacity();
+
+        pthread_mutex_lock(&bufMutex);
+
+        if (duration > stats.maxCallbackTime)
+            stats.maxCallbackTime = duration;
+
+        if (torn)
+            stats.framesTorn++;
 
+        callbackRunning = false;
+        pthread_cond_broadcast(&stateCond);
         pthread_mutex_unlock(&bufMutex);
     }
 }
 
 
-bool processPdm(const unsigned short *pdmBuffer, int size) {
-    int remaining = PCMsize - PCMindex;
-    int length = min(remaining, size);
+void processPdm(const unsigned short *pdmBuffer, int size) {
+    unsigned int consumed = 0;
+    unsigned int space, produced;
 
-    for (int i = 0; i < length; i++){
-        processingBuffer[PCMindex++] = PDMFilter(pdmBuffer, i);
-    }
+    while (consumed < (unsigned int) size) {
+        short *pcm = ring->getWritePointer(space);
 
-    return PCMindex >= PCMsize;
-}
+        if (space == 0) {
+            // The ring is full of pre-roll samples not yet saved: drop the rest of the buffer
+            stats.samplesDropped += (size - consumed) * 16 / DecimationChain::getDecimation(decimatorRate);
+            break;
+        }
 
+        consumed += decimator->process(pdmBuffer + consumed, size - consumed, pcm, space, produced);
 
+        if (monitor)
+            monitor(monitorContext, pcm, produced);
 
-short PDMFilter(const unsigned short *pdmBuffer, unsigned int index) {
-    static const char filterOrder = 4;
-    static unsigned short intReg[filterOrder] = {0,0,0,0};
-    static unsigned short combReg[filterOrder] = {0,0,0,0};
-    static signed char pdmLUT[] = {-1, 1};
+        bool complete = ring->commit(produced);
+        samplesWritten = samplesWritten + produced;
 
-    short combInput, combRes = 0;
-    
-    // Perform integration on the first word of the PDM chunk to be filtered
-    for (unsigned short i = 0; i < 16; i++){
-        // Integrate each single bit
-        intReg[0] += pdmLUT[(pdmBuffer[index] >> (15u - i)) & 1u];
-        
-        for (short j=1; j < filterOrder; j++){
-            intReg[j] += intReg[j-1];
+        if (complete) {
+            frameReady(ring->getFrame(), ring->getFrameStart());
         }
     }
-    
-    // The last cell of intReg contains the output of the integrator stage
-    combInput = intReg[filterOrder-1];
-    
-    // Apply the comb filter (with delay 1):
-    for (unsigned short &i : combReg){
-        combRes = combInput - i;
-        i = combInput;
-        combInput = combRes;
-    }
-    
-    return combRes;
+
+    if (freezeRequested)
+        freezeRing();
+}
+
+
+void freezeRing() {
+    pthread_mutex_lock(&bufMutex);
+    frozenSamples = ring->freeze();
+    freezeRequested = false;
+    pthread_cond_broadcast(&stateCond);
+    pthread_mutex_unlock(&bufMutex);
+}
+
+
+void frameReady(const short *frame, unsigned long long start) {
+    // Start critical section
+    pthread_mutex_lock(&bufMutex);
+
+    // The previous frame has not been taken by the callback thread yet
+    if (isBufferReady)
+        stats.framesOverwritten++;
+
+    readyFrame = frame;
+    readyFrameStart = start;
+    isBufferReady = true;
+    stats.framesProduced++;
+
+    pthread_cond_broadcast(&cbackExecCond);
+    pthread_mutex_unlock(&bufMutex);
+    // End critical section
 }
@@ -18,9 +18,22 @@
 #ifndef MICROPHONE_H
 #define MICROPHONE_H
 
-#include <functional>
+#include "../audio/audio_source.h"
+
+/**
+ * Capture statistics, collected since the start of the recording
+ */
+typedef struct {
+    unsigned int dmaStarvations;    // Times the DMA stopped because no PDM buffer was free
+    unsigned int pdmBlocksLost;     // PDM buffers not recorded while the DMA was stopped
+    unsigned int framesProduced;    // Frames handed to the callback thread
+    unsigned int framesOverwritten; // Frames replaced by a newer one before the callback could get them
+    unsigned int framesTorn;        // Frames whose samples were overwritten while the callback was reading them
+    unsigned int maxCallbackTime;   // Longest callback execution, in microseconds
+    unsigned int startLatency;      // Time from the start of the recording to the first callback, in microseconds
+    unsigned int samplesDropped;    // PCM samples not recorded because the ring was full of pre-roll to be saved
+} MicrophoneStats;
 
-using namespace std;
 
 class Microphone {
 public:
@@ -28,21 +41,153 @@ public:
     Microphone() = delete;
     
     /**
-     * Start the recording.
+     * Start the recording, delivering the frames to a function known at compile time.
+     * The sink receives the last frameSize samples every hopSize samples, so consecutive
+     * frames overlap by frameSize - hopSize samples. The frame points into the PCM history and
+     * is overwritten after other hopSize samples have been recorded.
      *
-     * @param callback      function to be called when the samples are ready (the function will
-     *                      receive, as parameters, the samples data pointer and its length)
-     * @param bufferSize    how many samples to collect before executing the callback
+     * @tparam Sink         function to be called when the samples are ready (it receives the
+     *                      samples data pointer, their amount and the index of the first one
+     *                      since the start of the recording)
+     * @param frameSize     how many samples to pass to the sink
+     * @param hopSize       how many new samples to collect before executing the sink
+     *                      (must divide frameSize)
+     * @param rate          PCM sample rate
      *
      * @return true if the recording process has started successfully; false otherwise
      */
-    static bool start(function<void (short*, unsigned int)> callback, unsigned int bufferSize);
+    template<void (*Sink)(const short*, unsigned int, unsigned long long)>
+    static bool start(unsigned int frameSize, unsigned int hopSize, PcmRate rate = PCM_32KHZ) {
+        return startSink(&callSinkFunction<Sink>, nullptr, frameSize, hopSize, rate);
+    }
+
+
+    /**
+     * Start the recording, delivering the frames to an object.
+     * Same as the other overload, but the sink is an object whose operator() has the signature
+     * void (const short*, unsigned int, unsigned long long). The object is not copied, so it
+     * must outlive the recording.
+     *
+     * @param sink          object to be called when the samples are ready
+     * @param frameSize     how many samples to pass to the sink
+     * @param hopSize       how many new samples to collect before executing the sink
+     *                      (must divide frameSize)
+     * @param rate          PCM sample rate
+     *
+     * @return true if the recording process has started successfully; false otherwise
+     */
+    template<typename Sink>
+    static bool start(Sink &sink, unsigned int frameSize, unsigned int hopSize, PcmRate rate = PCM_32KHZ) {
+        return startSink(&callSinkObject<Sink>, &sink, frameSize, hopSize, rate);
+    }
     
     /**
-     * Stop the recording.
+     * Pause the recording.
+     * The hardware, the threads and the buffers are kept alive, so that the next start only has
+     * to resume the transcoding. The sink is not called anymore once this function returns.
      */
     static void stop();
 
+    /**
+     * Stop the recording and release the hardware, the threads and the buffers.
+     */
+    static void release();
+
+    /**
+     * Get the nominal PCM sample rate of the current recording.
+     *
+     * @return sample rate in Hz; 0 if the recording has never been started
+     */
+    static unsigned int getSampleRate();
+
+    /**
+     * Get the PCM sample rate of the current recording, as obtained from the clock of the
+     * microphone (see i2s_clock.h).
+     *
+     * @return sample rate in Hz; 0 if the recording has never been started
+     */
+    static float getExactSampleRate();
+
+    /**
+     * Set the duration of the pre-roll, that is the audio retained to be saved when an event
+     * occurs. The retained audio is kept in the PCM history, so it costs memory but no copies.
+     * Applied from the next start.
+     *
+     * @param milliseconds  pre-roll duration (0 to disable it)
+     */
+    static void setPreRoll(unsigned int milliseconds);
+
+    /**
+     * Freeze the pre-roll, so that it can be read with getPreRoll.
+     * The recording goes on, but if the pre-roll is not released fast enough the new samples
+     * are dropped (see MicrophoneStats::samplesDropped).
+     *
+     * @return number of samples frozen; 0 if the pre-roll is disabled or the previous one
+     *         has not been released yet
+     */
+    static unsigned int freezePreRoll();
+
+    /**
+     * Get the oldest frozen pre-roll samples not yet released.
+     * The samples are read in place: release them as soon as they have been saved.
+     *
+     * @param count     number of samples available contiguously (0 when all the pre-roll
+     *                  has been released)
+     * @return pointer to the samples
+     */
+    static const short* getPreRoll(unsigned int &count);
+
+    /**
+     * Release the oldest frozen pre-roll samples.
+     * The recording can't be started again until all the pre-roll has been released.
+     *
+     * @param count     number of samples (not more than the ones returned by getPreRoll)
+     */
+    static void releasePreRoll(unsigned int count);
+
+    /**
+     * Set a stage receiving the PCM samples as soon as they are decimated, in the transcoding
+     * thread (see AudioSource::setMonitor). It can only be changed while the recording is
+     * stopped.
+     *
+     * @param monitor   object with a void process(const short*, unsigned int) method, or nullptr
+     */
+    template<typename Monitor>
+    static void setMonitor(Monitor *monitor) {
+        setMonitorHandler(monitor ? &callMonitorObject<Monitor> : nullptr, monitor);
+    }
+
+    /**
+     * Get the capture statistics of the current (or last) recording.
+     *
+     * @return statistics
+     */
+    static MicrophoneStats getStats();
+
+private:
+    friend class MicrophoneSource;
+
+    static bool startSink(FrameHandler handler, void *context, unsigned int frameSize,
+                          unsigned int hopSize, PcmRate rate);
+
+    static void setMonitorHandler(PcmHandler handler, void *context);
+};
+
+
+/**
+ * Microphone seen as a generic audio source.
+ * All the instances refer to the same microphone.
+ */
+class MicrophoneSource : public AudioSource {
+public:
+    void stop() override;
+    unsigned int getSampleRate() override;
+    float getExactSampleRate() override;
+
+protected:
+    bool startSink(FrameHandler handler, void *context, unsigned int frameSize,
+                   unsigned int hopSize, PcmRate rate) override;
+    void setMonitorHandler(PcmHandler handler, void *context) override;
 };
 
 #endif /* MICROPHONE_H */
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../miosix-kernel/src/audio/activity_detector.h"
+
+#define FRAME_SIZE 1024
+#define HOP_SIZE 256
+#define SAMPLE_RATE 32000
+#define FRAMES_PER_SECOND (SAMPLE_RATE / HOP_SIZE)
+
+// Checks the noise floor of the activity detector on the host: a whistle 20 dB above the room
+// must stay active for all its duration, while a stationary noise 15 dB louder than the previous
+// background (a fan turning on) must become part of the background within MAX_ADAPTATION seconds.
+//
+// Compile with: g++ tests/activity_test.cpp miosix-kernel/src/audio/activity_detector.cpp -o activity_test
+// (or make -C tests)
+
+#define MAX_ADAPTATION 30
+
+int main() {
+	short frame[FRAME_SIZE];
+	int failures = 0;
+	srand(1);
+	
+	// Whistle of 5 seconds after 2 seconds of background
+	{
+		ActivityDetector activity((float) HOP_SIZE / SAMPLE_RATE);
+		int active = 0, frames = 0;
+		
+		for (int f = 0; f < 7 * FRAMES_PER_SECOND; f++) {
+			bool whistle = f >= 2 * FRAMES_PER_SECOND;
+			
+			for (int i = 0; i < FRAME_SIZE; i++) {
+				float value = rand() % 200 - 100;
+				
+				if (whistle)
+					value += 3000 * sinf(2 * M_PI * 2000 * (f * HOP_SIZE + i) / SAMPLE_RATE);
+				
+				frame[i] = (short) value;
+			}
+			
+			bool result = activity.process(frame, FRAME_SIZE);
+			
+			if (whistle) {
+				frames++;
+				active += result;
+			}
+		}
+		
+		bool passed = active == frames;
+		failures += !passed;
+		printf("[%s] whistle: %d active frames out of %d\n", passed ? "PASS" : "FAIL", active, frames);
+	}
+	
+	// Noise 15 dB louder after 2 seconds
+	{
+		ActivityDetector activity((float) HOP_SIZE / SAMPLE_RATE);
+		int lastActive = 0;
+		
+		for (int f = 0; f < 60 * FRAMES_PER_SECOND; f++) {
+			float gain = f >= 2 * FRAMES_PER_SECOND ? 5.62f : 1;
+			
+			for (int i = 0; i < FRAME_SIZE; i++) {
+				frame[i] = (short) (gain * (rand() % 2000 - 1000));
+			}
+			
+			if (activity.process(frame, FRAME_SIZE))
+				lastActive = f;
+		}
+		
+		float adaptation = (float) (lastActive - 2 * FRAMES_PER_SECOND) / FRAMES_PER_SECOND;
+		bool passed = adaptation <= MAX_ADAPTATION;
+		failures += !passed;
+		printf("[%s] noise step: absorbed after %.1f s (limit %d s), noise floor %.1f dB, energy %.1f dB\n",
+				passed ? "PASS" : "FAIL", adaptation, MAX_ADAPTATION, activity.getNoiseFloor(), activity.getEnergy());
+	}
+	
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
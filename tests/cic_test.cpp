@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../miosix-kernel/src/pdm/pdm_decimator.h"
+
+#define WORDS 4096
+
+// Checks on the host that the table driven CIC decimator (PdmDecimator) is bit-exact with a
+// CIC filter integrating one bit at a time, for the orders and the decimation factors used by
+// the decimation chains, on random PDM streams and on a sigma-delta modulated sine, processed
+// in blocks of different sizes and interleaved with another channel.
+//
+// Compile with: g++ tests/cic_test.cpp -o cic_test (or make -C tests)
+
+// Reference CIC filter, with the same output scaling of PdmDecimator
+template<unsigned int Order, unsigned int Decimation>
+class BitSerialCic {
+public:
+	BitSerialCic() : phase(0) {
+		for (unsigned int i = 0; i < Order; i++) {
+			intReg[i] = 0;
+			combReg[i] = 0;
+		}
+	}
+	
+	unsigned int process(const unsigned short *pdm, unsigned int words, short *pcm) {
+		unsigned int produced = 0;
+		
+		for (unsigned int w = 0; w < words; w++) {
+			for (unsigned int i = 0; i < 16; i++) {
+				intReg[0] += (pdm[w] >> (15u - i)) & 1u ? 1 : -1;
+				
+				for (unsigned int j = 1; j < Order; j++) {
+					intReg[j] += intReg[j - 1];
+				}
+				
+				if (++phase == Decimation) {
+					phase = 0;
+					pcm[produced++] = comb();
+				}
+			}
+		}
+		
+		return produced;
+	}
+	
+private:
+	short comb() {
+		long long value = intReg[Order - 1];
+		
+		for (unsigned int i = 0; i < Order; i++) {
+			long long delayed = combReg[i];
+			combReg[i] = value;
+			value -= delayed;
+		}
+		
+		// The gain is Decimation^Order: scale it to 2^16
+		int bits = 0;
+		
+		for (unsigned int i = 1; i < Decimation; i *= 2) {
+			bits += Order;
+		}
+		
+		value = bits > 16 ? value >> (bits - 16) : value * (1 << (16 - bits));
+		return value > 32767 ? 32767 : value < -32768 ? -32768 : (short) value;
+	}
+	
+	long long intReg[Order];
+	long long combReg[Order];
+	unsigned int phase;
+};
+
+// First order sigma-delta modulation of a sine, as produced by a PDM microphone
+static void modulateSine(unsigned short *pdm, unsigned int words, float amplitude, float period) {
+	float error = 0;
+	
+	for (unsigned int w = 0; w < words; w++) {
+		unsigned short word = 0;
+		
+		for (unsigned int i = 0; i < 16; i++) {
+			float x = amplitude * sinf(2 * M_PI * (w * 16 + i) / period);
+			int bit = x - error >= 0;
+			error += (bit ? 1 : -1) - x;
+			word = (word << 1) | bit;
+		}
+		
+		pdm[w] = word;
+	}
+}
+
+template<unsigned int Order, unsigned int Decimation>
+static bool compare(const char *name) {
+	static unsigned short pdm[WORDS];
+	static unsigned short interleaved[2 * WORDS];
+	static short reference[WORDS * 16 / Decimation + 1];
+	static short output[WORDS * 16 / Decimation + 1];
+	static short blockOutput[WORDS * 16 / Decimation + 1];
+	unsigned int samples = 0, mismatches = 0;
+	
+	for (int stream = 0; stream < 4; stream++) {
+		if (stream < 2) {
+			for (unsigned int i = 0; i < WORDS; i++) {
+				pdm[i] = rand() & 0xffffu;
+			}
+		} else {
+			modulateSine(pdm, WORDS, stream == 2 ? 0.5f : 0.99f, 1000 + 300 * stream);
+		}
+		
+		for (unsigned int i = 0; i < WORDS; i++) {
+			interleaved[2 * i] = pdm[i];
+			interleaved[2 * i + 1] = rand() & 0xffffu;
+		}
+		
+		BitSerialCic<Order, Decimation> bitSerial;
+		PdmDecimator<Order, Decimation> decimator, blockDecimator, strideDecimator;
+		
+		unsigned int count = bitSerial.process(pdm, WORDS, reference);
+		
+		// Whole stream, blocks of odd sizes and one channel of an interleaved stream
+		unsigned int produced = decimator.process(pdm, WORDS, output);
+		unsigned int blockProduced = 0;
+		
+		for (unsigned int start = 0, size = 1; start < WORDS; start += size, size = size * 3 % 37 + 1) {
+			unsigned int words = start + size < WORDS ? size : WORDS - start;
+			blockProduced += blockDecimator.process(pdm + start, words, blockOutput + blockProduced);
+		}
+		
+		if (produced != count || blockProduced != count) {
+			printf("[FAIL] %s: %u samples expected, %u and %u produced\n", name, count, produced, blockProduced);
+			return false;
+		}
+		
+		for (unsigned int i = 0; i < count; i++) {
+			mismatches += output[i] != reference[i];
+			mismatches += blockOutput[i] != reference[i];
+		}
+		
+		strideDecimator.process(interleaved, WORDS, output, 2);
+		
+		for (unsigned int i = 0; i < count; i++) {
+			mismatches += output[i] != reference[i];
+		}
+		
+		samples += count;
+	}
+	
+	printf("[%s] %s: %u samples, %u mismatches\n", mismatches == 0 ? "PASS" : "FAIL", name, samples, mismatches);
+	return mismatches == 0;
+}
+
+int main() {
+	srand(1);
+	bool passed = true;
+	
+	passed &= compare<4, 16>("order 4, decimation 16");
+	passed &= compare<4, 8>("order 4, decimation 8");
+	passed &= compare<4, 32>("order 4, decimation 32");
+	passed &= compare<4, 64>("order 4, decimation 64");
+	passed &= compare<5, 32>("order 5, decimation 32");
+	passed &= compare<3, 16>("order 3, decimation 16");
+	
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
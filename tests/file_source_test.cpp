@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "../miosix-kernel/src/audio/file_source.h"
+
+#define FRAME_SIZE 1024
+#define HOP_SIZE 256
+
+// Streams synthetic recordings through FileAudioSource, from memory and from a file, and checks
+// the frames given to the sink: their number, the index of their first sample and their
+// samples, compared with the PCM recording or with the output of a DecimationChain run on the
+// whole PDM recording. The monitor must see every sample once, in order. A WAV recording can
+// also be given as argument, to check it with the same rules.
+//
+// Compile with: g++ -std=gnu++11 tests/file_source_test.cpp miosix-kernel/src/audio/file_source.cpp
+//               miosix-kernel/src/audio/pcm_ring.cpp miosix-kernel/src/pdm/decimator.cpp -lpthread
+//               -o file_source_test
+// (or make -C tests)
+
+// Sink and monitor checking the stream against the expected PCM samples
+class Checker {
+public:
+	Checker(const std::vector<short> &expected) : expected(expected), frames(0), errors(0), monitored(0) {
+		
+	}
+	
+	void operator()(const short *frame, unsigned int n, unsigned long long firstSample) {
+		if (n != FRAME_SIZE || firstSample != (unsigned long long) frames * HOP_SIZE ||
+				firstSample + n > expected.size() ||
+				memcmp(frame, &expected[firstSample], n * sizeof(short)) != 0) {
+			errors++;
+		}
+		
+		frames++;
+	}
+	
+	void process(const short *pcm, unsigned int n) {
+		if (monitored + n > expected.size() ||
+				memcmp(pcm, &expected[monitored], n * sizeof(short)) != 0) {
+			errors++;
+		}
+		
+		monitored += n;
+	}
+	
+	// Check the counters at the end of the stream
+	bool check(const char *name) {
+		unsigned int expectedFrames = expected.size() >= FRAME_SIZE ? (expected.size() - FRAME_SIZE) / HOP_SIZE + 1 : 0;
+		bool passed = errors == 0 && frames == expectedFrames && monitored == expected.size();
+		
+		printf("[%s] %s: %u frames (%u expected), %u samples monitored (%u expected), %u errors\n",
+				passed ? "PASS" : "FAIL", name, frames, expectedFrames, monitored,
+				(unsigned int) expected.size(), errors);
+		
+		frames = 0;
+		errors = 0;
+		monitored = 0;
+		return passed;
+	}
+	
+private:
+	const std::vector<short> &expected;
+	unsigned int frames;
+	unsigned int errors;
+	unsigned int monitored;
+};
+
+// Stream a recording twice, to check that a new start rewinds it
+static bool stream(FileAudioSource &source, const std::vector<short> &expected, const char *name) {
+	Checker checker(expected);
+	source.setMonitor(&checker);
+	bool passed = true;
+	
+	for (int i = 0; i < 2; i++) {
+		if (!source.start(checker, FRAME_SIZE, HOP_SIZE, PCM_32KHZ)) {
+			printf("[FAIL] %s: the stream didn't start\n", name);
+			return false;
+		}
+		
+		source.wait();
+		passed &= checker.check(name);
+	}
+	
+	return passed;
+}
+
+static void putLittleEndian(std::vector<unsigned char> &bytes, unsigned int value, unsigned int size) {
+	for (unsigned int i = 0; i < size; i++) {
+		bytes.push_back((value >> (8 * i)) & 0xffu);
+	}
+}
+
+// WAV recording with the samples in the first channel and noise in the others, with an extra
+// chunk before the samples
+static std::vector<unsigned char> makeWav(const std::vector<short> &samples, unsigned int channels) {
+	std::vector<unsigned char> wav;
+	unsigned int dataSize = samples.size() * channels * 2;
+	
+	wav.insert(wav.end(), "RIFF", "RIFF" + 4);
+	putLittleEndian(wav, 4 + 24 + 14 + 8 + dataSize, 4);
+	wav.insert(wav.end(), "WAVEfmt ", "WAVEfmt " + 8);
+	putLittleEndian(wav, 16, 4);
+	putLittleEndian(wav, 1, 2);
+	putLittleEndian(wav, channels, 2);
+	putLittleEndian(wav, PCM_32KHZ, 4);
+	putLittleEndian(wav, PCM_32KHZ * channels * 2, 4);
+	putLittleEndian(wav, channels * 2, 2);
+	putLittleEndian(wav, 16, 2);
+	wav.insert(wav.end(), "LIST", "LIST" + 4);
+	putLittleEndian(wav, 5, 4);
+	wav.insert(wav.end(), 6, 0);
+	wav.insert(wav.end(), "data", "data" + 4);
+	putLittleEndian(wav, dataSize, 4);
+	
+	for (unsigned int i = 0; i < samples.size(); i++) {
+		putLittleEndian(wav, (unsigned short) samples[i], 2);
+		
+		for (unsigned int c = 1; c < channels; c++) {
+			putLittleEndian(wav, rand() & 0xffffu, 2);
+		}
+	}
+	
+	return wav;
+}
+
+// Samples of a WAV file, first channel only
+static bool readWav(const char *path, std::vector<short> &samples) {
+	FILE *file = fopen(path, "rb");
+	
+	if (file == NULL)
+		return false;
+	
+	std::vector<unsigned char> bytes;
+	unsigned char buffer[4096];
+	size_t count;
+	
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		bytes.insert(bytes.end(), buffer, buffer + count);
+	}
+	
+	fclose(file);
+	size_t position = 12;
+	unsigned int channels = 0;
+	
+	while (bytes.size() >= 12 && position + 8 <= bytes.size()) {
+		const unsigned char *chunk = &bytes[position];
+		size_t size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((size_t) chunk[7] << 24);
+		
+		if (memcmp(chunk, "fmt ", 4) == 0) {
+			channels = chunk[10] | (chunk[11] << 8);
+		} else if (memcmp(chunk, "data", 4) == 0 && channels > 0) {
+			size = size < bytes.size() - position - 8 ? size : bytes.size() - position - 8;
+			
+			for (size_t i = 0; i + 2 * channels <= size; i += 2 * channels) {
+				samples.push_back((short) (chunk[8 + i] | (chunk[9 + i] << 8)));
+			}
+			
+			return true;
+		}
+		
+		position += 8 + size + (size & 1);
+	}
+	
+	return false;
+}
+
+int main(int argc, char **argv) {
+	srand(1);
+	bool passed = true;
+	
+	// PCM and WAV: the frames are made of the recorded samples
+	std::vector<short> pcm(32000 + 123);
+	
+	for (unsigned int i = 0; i < pcm.size(); i++) {
+		pcm[i] = (short) (rand() & 0xffffu);
+	}
+	
+	FileAudioSource pcmSource(&pcm[0], pcm.size() * sizeof(short), AUDIO_PCM);
+	passed &= stream(pcmSource, pcm, "PCM from memory");
+	
+	std::vector<unsigned char> wav = makeWav(pcm, 3);
+	FileAudioSource wavSource(&wav[0], wav.size(), AUDIO_WAV);
+	passed &= stream(wavSource, pcm, "3 channel WAV from memory");
+	
+	char path[] = "/tmp/file_source_testXXXXXX";
+	int fd = mkstemp(path);
+	
+	if (fd < 0 || write(fd, &wav[0], wav.size()) != (ssize_t) wav.size()) {
+		printf("[FAIL] The temporary file can't be written\n");
+		return EXIT_FAILURE;
+	}
+	
+	close(fd);
+	
+	{
+		FileAudioSource fileSource(path, AUDIO_WAV);
+		passed &= stream(fileSource, pcm, "3 channel WAV from file");
+	}
+	
+	unlink(path);
+	
+	// PDM: the frames are made of the output of the decimation chain on the whole recording
+	std::vector<unsigned short> pdm(16000 + 77);
+	
+	for (unsigned int i = 0; i < pdm.size(); i++) {
+		pdm[i] = rand() & 0xffffu;
+	}
+	
+	DecimationChain decimator(PCM_32KHZ);
+	std::vector<short> decimated(pdm.size() * 16 / DecimationChain::getDecimation(PCM_32KHZ) + 16);
+	unsigned int consumed = 0, samples = 0, produced;
+	
+	while (consumed < pdm.size()) {
+		consumed += decimator.process(&pdm[consumed], pdm.size() - consumed, &decimated[samples],
+				decimated.size() - samples, produced);
+		samples += produced;
+	}
+	
+	decimated.resize(samples);
+	FileAudioSource pdmSource(&pdm[0], pdm.size() * sizeof(unsigned short), AUDIO_PDM);
+	passed &= stream(pdmSource, decimated, "PDM from memory");
+	
+	// Recording given by the user
+	if (argc >= 2) {
+		std::vector<short> recording;
+		
+		if (!readWav(argv[1], recording)) {
+			printf("[FAIL] %s can't be read\n", argv[1]);
+			return EXIT_FAILURE;
+		}
+		
+		FileAudioSource recordingSource(argv[1], AUDIO_WAV);
+		passed &= stream(recordingSource, recording, argv[1]);
+	}
+	
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
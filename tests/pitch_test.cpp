@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../miosix-kernel/src/fft/pitch_estimator.h"
+
+#define FFT_SIZE 1024
+#define BIN_AMOUNT (FFT_SIZE / 2)
+#define SAMPLE_RATE 32000
+
+// Maximum pitch error with the Hann window (2% of a bin, see pitch_estimator.h), in Hz
+#define MAX_ERROR (0.02f * SAMPLE_RATE / FFT_SIZE)
+
+// Checks the pitch estimator on the host, with the bins computed by a plain DFT instead of the
+// CMSIS FFT: the pitch of the tones in the range must be within MAX_ERROR, and the white noise
+// must not have any pitch.
+//
+// Compile with: g++ tests/pitch_test.cpp miosix-kernel/src/fft/pitch_estimator.cpp -o pitch_test
+// (or make -C tests)
+
+static float window[FFT_SIZE];
+
+// Hann window and magnitude, power or dB of the first BIN_AMOUNT bins of a frame
+static void computeBins(const float *frame, FftOutput outputType, float *bins) {
+	for (int k = 0; k < BIN_AMOUNT; k++) {
+		double re = 0, im = 0;
+		
+		for (int n = 0; n < FFT_SIZE; n++) {
+			double phase = 2 * M_PI * (double) k * n / FFT_SIZE;
+			re += frame[n] * window[n] * cos(phase);
+			im -= frame[n] * window[n] * sin(phase);
+		}
+		
+		double power = re * re + im * im;
+		
+		if (outputType == FFT_MAGNITUDE) {
+			bins[k] = sqrt(power);
+		} else if (outputType == FFT_POWER) {
+			bins[k] = power;
+		} else {
+			bins[k] = power > 1e-12 ? 10 * log10(power) : -120;
+		}
+	}
+}
+
+int main() {
+	const FftOutput outputTypes[] = { FFT_MAGNITUDE, FFT_POWER, FFT_LOG_POWER };
+	const char *outputNames[] = { "magnitude", "power", "log power" };
+	
+	float frame[FFT_SIZE];
+	float bins[BIN_AMOUNT];
+	int failures = 0;
+	
+	for (int n = 0; n < FFT_SIZE; n++) {
+		window[n] = 0.5f - 0.5f * cosf(2 * M_PI * n / FFT_SIZE);
+	}
+	
+	srand(1);
+	
+	for (int type = 0; type < 3; type++) {
+		PitchEstimator pitch(FFT_SIZE, SAMPLE_RATE, 400, 4000, outputTypes[type]);
+		float maxError = 0;
+		int missed = 0;
+		
+		// Tones between two bins and at random positions, with a weak noise
+		for (int i = 0; i < 50; i++) {
+			float frequency = 450 + 3500.0f * i / 50 + 7.3f * (rand() % 5);
+			float amplitude = 0.05f + 0.9f * rand() / RAND_MAX;
+			float phase = 2 * M_PI * rand() / RAND_MAX;
+			
+			for (int n = 0; n < FFT_SIZE; n++) {
+				float noise = 0.001f * (2.0f * rand() / RAND_MAX - 1);
+				frame[n] = amplitude * sinf(2 * M_PI * frequency * n / SAMPLE_RATE + phase) + noise;
+			}
+			
+			computeBins(frame, outputTypes[type], bins);
+			float estimate = pitch.process(bins);
+			
+			if (estimate == 0) {
+				missed++;
+			} else if (fabsf(estimate - frequency) > maxError) {
+				maxError = fabsf(estimate - frequency);
+			}
+		}
+		
+		// White noise
+		int noisy = 0;
+		
+		for (int i = 0; i < 20; i++) {
+			for (int n = 0; n < FFT_SIZE; n++) {
+				frame[n] = 0.5f * (2.0f * rand() / RAND_MAX - 1);
+			}
+			
+			computeBins(frame, outputTypes[type], bins);
+			noisy += pitch.process(bins) != 0;
+		}
+		
+		bool passed = missed == 0 && maxError <= MAX_ERROR && noisy == 0;
+		failures += !passed;
+		
+		printf("[%s] %s: max error %.3f Hz (limit %.3f Hz), %d tones missed, %d noise frames with a pitch\n",
+				passed ? "PASS" : "FAIL", outputNames[type], maxError, MAX_ERROR, missed, noisy);
+	}
+	
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}